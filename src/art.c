@@ -0,0 +1,611 @@
+//
+// Album art loading, see art.h
+//
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <SDL_image.h>
+#include "sys/stat.h"
+#include "dirent.h"
+#include "art.h"
+#include "util.h"
+#include "mem.h"
+
+#include <stdlib.h>
+
+// largest ID3 tag / FLAC picture block we are willing to read into memory
+#define ART_TAG_MAX (16 * 1024 * 1024)
+
+typedef enum {
+    ART_LOADING,
+    ART_READY,
+    ART_NONE
+} ArtStatus;
+
+typedef struct {
+    char key[ART_PATH_MAX];
+    SDL_Texture* texture;
+    ArtStatus status;
+    Uint64 lastUse;
+    bool used;
+} ArtEntry;
+
+typedef struct {
+    char key[ART_PATH_MAX];
+    SDL_Surface* surface; // NULL when the track has no art
+} ArtResult;
+
+static char musicDir[ART_PATH_MAX];
+static char cacheDir[ART_PATH_MAX];
+static ArtEntry entries[ART_CACHE_TEXTURES];
+static Uint64 useCounter = 0;
+
+// shared with the worker, guarded by lock. every queued key or pending result
+// belongs to an ART_LOADING entry, so neither can outgrow ART_CACHE_TEXTURES
+static SDL_Thread* worker = NULL;
+static SDL_mutex* lock = NULL;
+static SDL_cond* wake = NULL;
+static bool quitting = false;
+static char queue[ART_QUEUE_MAX][ART_PATH_MAX];
+static int queueSize = 0;
+static ArtResult results[ART_QUEUE_MAX];
+static int resultCount = 0;
+
+//DECODING
+static Uint32 be32(const Uint8* b) {
+    return (Uint32) b[0] << 24 | (Uint32) b[1] << 16 | (Uint32) b[2] << 8 | b[3];
+}
+
+static Uint32 be24(const Uint8* b) {
+    return (Uint32) b[0] << 16 | (Uint32) b[1] << 8 | b[2];
+}
+
+static Uint32 synchsafe(const Uint8* b) {
+    return (Uint32) (b[0] & 0x7f) << 21 | (Uint32) (b[1] & 0x7f) << 14 | (Uint32) (b[2] & 0x7f) << 7 | (b[3] & 0x7f);
+}
+
+// drop the 0x00 stuffed after every 0xff, returns the new length
+static Uint32 deunsync(Uint8* buf, const Uint32 len) {
+    Uint32 out = 0;
+    for (Uint32 i = 0; i < len; i++) {
+        buf[out++] = buf[i];
+        if (buf[i] == 0xff && i + 1 < len && buf[i + 1] == 0x00) {
+            i++;
+        }
+    }
+    return out;
+}
+
+static SDL_Surface* decodeImage(const Uint8* data, const Uint32 len) {
+    if (len == 0 || len > ART_TAG_MAX) {
+        return NULL;
+    }
+    return IMG_Load_RW(SDL_RWFromConstMem(data, (int) len), 1);
+}
+
+// APIC (v2.3/v2.4) and PIC (v2.2) frame bodies, returns the image bytes
+static const Uint8* parsePictureFrame(const Uint8* body, const Uint32 len, const int version, Uint32* picLen, bool* front) {
+    if (len < 4) {
+        return NULL;
+    }
+    const Uint8 encoding = body[0];
+    Uint32 p = 1;
+    if (version == 2) {
+        p += 3; // image format, e.g. "JPG"
+    } else {
+        while (p < len && body[p] != 0) {
+            p++;
+        }
+        p++;
+    }
+    if (p >= len) {
+        return NULL;
+    }
+    *front = body[p++] == 3;
+    if (encoding == 1 || encoding == 2) {
+        while (p + 1 < len && (body[p] != 0 || body[p + 1] != 0)) {
+            p += 2;
+        }
+        p += 2;
+    } else {
+        while (p < len && body[p] != 0) {
+            p++;
+        }
+        p++;
+    }
+    if (p >= len) {
+        return NULL;
+    }
+    *picLen = len - p;
+    return body + p;
+}
+
+static SDL_Surface* readId3Art(FILE* f, const Uint8* header) {
+    const int version = header[3];
+    const bool unsync = header[5] & 0x80;
+    const bool extended = header[5] & 0x40;
+    const Uint32 size = synchsafe(header + 6);
+    if (version < 2 || version > 4 || size > ART_TAG_MAX) {
+        return NULL;
+    }
+    Uint8* tag = malloc(size);
+    if (tag == NULL || fread(tag, 1, size, f) != size) {
+        free(tag);
+        return NULL;
+    }
+    Uint32 len = size;
+    if (unsync && version < 4) {
+        len = deunsync(tag, len);
+    }
+    Uint32 pos = 0;
+    if (extended && len >= 4) {
+        pos = version == 3 ? be32(tag) + 4 : synchsafe(tag);
+        pos = pos > len ? len : pos;
+    }
+    const Uint32 hdrLen = version == 2 ? 6 : 10;
+    const Uint8* best = NULL;
+    Uint32 bestLen = 0;
+    bool bestFront = false;
+    while (pos + hdrLen <= len && tag[pos] != 0) {
+        Uint8* frame = tag + pos;
+        const Uint32 frameLen = version == 2 ? be24(frame + 3) : version == 3 ? be32(frame + 4) : synchsafe(frame + 4);
+        if (frameLen > len - pos - hdrLen) {
+            break;
+        }
+        const bool isPicture = version == 2 ? memcmp(frame, "PIC", 3) == 0 : memcmp(frame, "APIC", 4) == 0;
+        if (isPicture) {
+            Uint8* body = frame + hdrLen;
+            Uint32 bodyLen = frameLen;
+            if (version == 4 && frame[9] & 0x02) {
+                bodyLen = deunsync(body, bodyLen);
+            }
+            if (version == 4 && frame[9] & 0x01 && bodyLen >= 4) {
+                body += 4; // data length indicator
+                bodyLen -= 4;
+            }
+            Uint32 picLen = 0;
+            bool front = false;
+            const Uint8* pic = parsePictureFrame(body, bodyLen, version, &picLen, &front);
+            if (pic != NULL && (best == NULL || (front && !bestFront))) {
+                best = pic;
+                bestLen = picLen;
+                bestFront = front;
+            }
+        }
+        pos += hdrLen + frameLen;
+    }
+    SDL_Surface* art = best != NULL ? decodeImage(best, bestLen) : NULL;
+    free(tag);
+    return art;
+}
+
+static SDL_Surface* readFlacArt(FILE* f) {
+    Uint8 block[4];
+    Uint8* best = NULL;
+    Uint32 bestOffset = 0;
+    Uint32 bestLen = 0;
+    bool bestFront = false;
+    if (fseek(f, 4, SEEK_SET) != 0) {
+        return NULL;
+    }
+    while (fread(block, 1, 4, f) == 4) {
+        const bool last = block[0] & 0x80;
+        const int type = block[0] & 0x7f;
+        const Uint32 len = be24(block + 1);
+        if (type != 6 || len > ART_TAG_MAX || (best != NULL && bestFront)) {
+            if (last || fseek(f, len, SEEK_CUR) != 0) {
+                break;
+            }
+            continue;
+        }
+        Uint8* data = malloc(len);
+        if (data == NULL || fread(data, 1, len, f) != len) {
+            free(data);
+            break;
+        }
+        // type, mime, description, width/height/depth/colors, data
+        Uint32 p = 4;
+        bool valid = len >= 32;
+        if (valid) {
+            const Uint32 mimeLen = be32(data + p);
+            valid = mimeLen <= len - p - 8;
+            p += 4 + mimeLen;
+        }
+        if (valid) {
+            const Uint32 descLen = be32(data + p);
+            valid = len - p >= 24 && descLen <= len - p - 24;
+            p += 4 + descLen + 16;
+        }
+        if (valid) {
+            const Uint32 picLen = be32(data + p);
+            p += 4;
+            valid = picLen <= len - p;
+            if (valid && (best == NULL || be32(data) == 3)) {
+                free(best);
+                best = data;
+                bestOffset = p;
+                bestLen = picLen;
+                bestFront = be32(data) == 3;
+                data = NULL;
+            }
+        }
+        free(data);
+        if (last) {
+            break;
+        }
+    }
+    SDL_Surface* art = best != NULL ? decodeImage(best + bestOffset, bestLen) : NULL;
+    free(best);
+    return art;
+}
+
+static SDL_Surface* loadEmbeddedArt(const char* trackPath) {
+    FILE* f = fopen(trackPath, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    Uint8 header[10];
+    SDL_Surface* art = NULL;
+    if (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+        if (memcmp(header, "ID3", 3) == 0) {
+            art = readId3Art(f, header);
+        } else if (memcmp(header, "fLaC", 4) == 0) {
+            art = readFlacArt(f);
+        }
+    }
+    fclose(f);
+    return art;
+}
+
+static SDL_Surface* loadIfExists(const char* path) {
+    if (access(path, R_OK) != 0) {
+        return NULL;
+    }
+    return IMG_Load(path);
+}
+
+// Artist-Title.jpg next to the track, then Artist.jpg, then cover/folder images
+static SDL_Surface* loadFolderArt(const char* trackPath) {
+    static const char* exts[] = {"jpg", "jpeg", "png"};
+    static const char* names[] = {"cover", "folder", "front"};
+    const int extCount = sizeof(exts) / sizeof(exts[0]);
+    const int nameCount = sizeof(names) / sizeof(names[0]);
+    const char* slash = strrchr(trackPath, '/');
+    const char* base = slash == NULL ? trackPath : slash + 1;
+    const int dirLen = slash == NULL ? 1 : (int) (slash - trackPath);
+    const char* dir = slash == NULL ? "." : trackPath;
+    const char* dot = strrchr(base, '.');
+    const int stemLen = dot == NULL ? (int) strlen(base) : (int) (dot - base);
+    const char* dash = strchr(base, '-');
+    int artistLen = dash == NULL || dash - base > stemLen ? stemLen : (int) (dash - base);
+    while (artistLen > 0 && base[artistLen - 1] == ' ') {
+        artistLen--;
+    }
+
+    char candidate[ART_PATH_MAX * 2];
+    SDL_Surface* art = NULL;
+    for (int i = 0; i < extCount && art == NULL; i++) {
+        snprintf(candidate, sizeof(candidate), "%.*s/%.*s.%s", dirLen, dir, stemLen, base, exts[i]);
+        art = loadIfExists(candidate);
+    }
+    for (int i = 0; i < extCount && art == NULL && artistLen > 0; i++) {
+        snprintf(candidate, sizeof(candidate), "%.*s/%.*s.%s", dirLen, dir, artistLen, base, exts[i]);
+        art = loadIfExists(candidate);
+    }
+    for (int n = 0; n < nameCount && art == NULL; n++) {
+        for (int i = 0; i < extCount && art == NULL; i++) {
+            snprintf(candidate, sizeof(candidate), "%.*s/%s.%s", dirLen, dir, names[n], exts[i]);
+            art = loadIfExists(candidate);
+        }
+    }
+    return art;
+}
+//END DECODING
+//SCALING
+// 2x2 box filter, keeps large covers from aliasing when stretched to thumb size
+static SDL_Surface* halveSurface(SDL_Surface* src) {
+    const int w = src->w / 2;
+    const int h = src->h / 2;
+    SDL_Surface* dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (dst == NULL) {
+        return NULL;
+    }
+    for (int y = 0; y < h; y++) {
+        const Uint32* r0 = (const Uint32*) ((const Uint8*) src->pixels + 2 * y * src->pitch);
+        const Uint32* r1 = (const Uint32*) ((const Uint8*) src->pixels + (2 * y + 1) * src->pitch);
+        Uint32* out = (Uint32*) ((Uint8*) dst->pixels + y * dst->pitch);
+        for (int x = 0; x < w; x++) {
+            const Uint32 a = r0[2 * x], b = r0[2 * x + 1], c = r1[2 * x], d = r1[2 * x + 1];
+            Uint32 px = 0;
+            for (int s = 0; s < 32; s += 8) {
+                const Uint32 sum = (a >> s & 0xff) + (b >> s & 0xff) + (c >> s & 0xff) + (d >> s & 0xff);
+                px |= (sum + 2) / 4 << s;
+            }
+            out[x] = px;
+        }
+    }
+    return dst;
+}
+
+static SDL_Surface* scaleToThumb(SDL_Surface* src) {
+    SDL_Surface* cur = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
+    while (cur != NULL && cur->w >= ART_THUMB_SIZE * 2 && cur->h >= ART_THUMB_SIZE * 2) {
+        SDL_Surface* half = halveSurface(cur);
+        SDL_FreeSurface(cur);
+        cur = half;
+    }
+    if (cur == NULL || (cur->w <= ART_THUMB_SIZE && cur->h <= ART_THUMB_SIZE)) {
+        return cur;
+    }
+    int w = ART_THUMB_SIZE;
+    int h = ART_THUMB_SIZE;
+    if (cur->w > cur->h) {
+        h = cur->h * ART_THUMB_SIZE / cur->w;
+    } else {
+        w = cur->w * ART_THUMB_SIZE / cur->h;
+    }
+    SDL_Surface* thumb = SDL_CreateRGBSurfaceWithFormat(0, w > 0 ? w : 1, h > 0 ? h : 1, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (thumb != NULL) {
+        SDL_SetSurfaceBlendMode(cur, SDL_BLENDMODE_NONE);
+        SDL_BlitScaled(cur, NULL, thumb, NULL);
+    }
+    SDL_FreeSurface(cur);
+    return thumb;
+}
+//END SCALING
+//WORKER
+// removes every file in dir except keep, NULL keeps nothing
+static void pruneDir(const char* dir, const char* keep) {
+    char path[ART_PATH_MAX * 2];
+    struct stat filestat;
+    DIR* dirp = opendir(dir);
+    if (dirp == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dirp))) {
+        if (entry->d_name[0] == '.' || (keep != NULL && strcmp(entry->d_name, keep) == 0)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (stat(path, &filestat) == 0 && S_ISREG(filestat.st_mode)) {
+            unlink(path);
+        }
+    }
+    closedir(dirp);
+}
+
+// thumbnails are cached in one dir per track name holding a single file for the
+// track's current size/mtime, so a changed track replaces its old entry. an empty
+// file marks "no art"
+static SDL_Surface* loadThumb(const char* trackName) {
+    char trackPath[ART_PATH_MAX * 2];
+    char entryDir[ART_PATH_MAX];
+    char entryName[32];
+    char cachePath[ART_PATH_MAX * 2];
+    struct stat filestat;
+    snprintf(trackPath, sizeof(trackPath), "%s/%s", musicDir, trackName);
+    if (stat(trackPath, &filestat) == -1) {
+        return NULL;
+    }
+    snprintf(entryDir, sizeof(entryDir), "%s/%lx", cacheDir, hash((unsigned char*) trackName));
+    snprintf(entryName, sizeof(entryName), "%lx.png", (unsigned long) filestat.st_mtime ^ (unsigned long) filestat.st_size);
+    snprintf(cachePath, sizeof(cachePath), "%s/%s", entryDir, entryName);
+    struct stat cachestat;
+    if (stat(cachePath, &cachestat) == 0) {
+        if (cachestat.st_size == 0) {
+            return NULL;
+        }
+        SDL_Surface* cached = IMG_Load(cachePath);
+        if (cached != NULL) {
+            return cached;
+        }
+    }
+
+    SDL_Surface* full = loadEmbeddedArt(trackPath);
+    if (full == NULL) {
+        full = loadFolderArt(trackPath);
+    }
+    SDL_Surface* thumb = NULL;
+    if (full != NULL) {
+        thumb = scaleToThumb(full);
+        SDL_FreeSurface(full);
+    }
+    mkdir(entryDir, 0755);
+    pruneDir(entryDir, entryName);
+    if (thumb == NULL) {
+        FILE* marker = fopen(cachePath, "w");
+        if (marker != NULL) {
+            fclose(marker);
+        }
+    } else if (IMG_SavePNG(thumb, cachePath) != 0) {
+        SDL_Log("Failed to cache art %s\nSDL_Error: %s", cachePath, SDL_GetError());
+    }
+    return thumb;
+}
+
+static int artWorker(void* data) {
+    char key[ART_PATH_MAX];
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    // flat "<name>_<stamp>.png" files from before entries got their own dir
+    pruneDir(cacheDir, NULL);
+    SDL_LockMutex(lock);
+    while (!quitting) {
+        if (queueSize == 0) {
+            SDL_CondWait(wake, lock);
+            continue;
+        }
+        // newest request first, it is the one currently on screen
+        strcpy(key, queue[--queueSize]);
+        SDL_UnlockMutex(lock);
+        SDL_Surface* thumb = loadThumb(key);
+        SDL_LockMutex(lock);
+        strcpy(results[resultCount].key, key);
+        results[resultCount].surface = thumb;
+        resultCount++;
+    }
+    SDL_UnlockMutex(lock);
+    return 0;
+}
+//END WORKER
+
+static void makeDirs(const char* path) {
+    char buf[ART_PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char* p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(buf, 0755);
+            *p = '/';
+        }
+    }
+    mkdir(buf, 0755);
+}
+
+bool art_init(const char* music, const char* cache) {
+    snprintf(musicDir, sizeof(musicDir), "%s", music);
+    snprintf(cacheDir, sizeof(cacheDir), "%s", cache);
+    makeDirs(cacheDir);
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    if (lock == NULL || wake == NULL) {
+        SDL_Log("Failed to create art worker lock!\nSDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    quitting = false;
+    worker = SDL_CreateThread(artWorker, "art", NULL);
+    if (worker == NULL) {
+        SDL_Log("Failed to start art worker!\nSDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+static long textureBytes(SDL_Texture* texture) {
+    int w = 0;
+    int h = 0;
+    SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+    return (long) w * h * 4;
+}
+
+static void dropTexture(ArtEntry* e) {
+    if (e->texture != NULL) {
+        mem_add(MEM_TEXTURES, -textureBytes(e->texture));
+        SDL_DestroyTexture(e->texture);
+    }
+    e->texture = NULL;
+}
+
+// least recently used thumbnails go first, never the one asked for last
+static void evictOverCap() {
+    while (mem_overCap(MEM_TEXTURES)) {
+        ArtEntry* victim = NULL;
+        for (int i = 0; i < ART_CACHE_TEXTURES; i++) {
+            ArtEntry* e = &entries[i];
+            if (e->used && e->texture != NULL && (victim == NULL || e->lastUse < victim->lastUse)) {
+                victim = e;
+            }
+        }
+        if (victim == NULL || victim->lastUse == useCounter) {
+            return;
+        }
+        dropTexture(victim);
+        victim->used = false;
+    }
+}
+
+SDL_Texture* art_get(const char* trackName) {
+    if (worker == NULL || trackName == NULL || strlen(trackName) >= ART_PATH_MAX) {
+        return NULL;
+    }
+    ArtEntry* victim = NULL;
+    for (int i = 0; i < ART_CACHE_TEXTURES; i++) {
+        ArtEntry* e = &entries[i];
+        if (!e->used) {
+            if (victim == NULL || victim->used) {
+                victim = e;
+            }
+        } else if (strcmp(e->key, trackName) == 0) {
+            e->lastUse = ++useCounter;
+            return e->texture;
+        } else if (e->status != ART_LOADING && (victim == NULL || (victim->used && e->lastUse < victim->lastUse))) {
+            victim = e;
+        }
+    }
+    if (victim == NULL) {
+        return NULL; // every slot is waiting on the worker, ask again next frame
+    }
+    dropTexture(victim);
+    strcpy(victim->key, trackName);
+    victim->status = ART_LOADING;
+    victim->lastUse = ++useCounter;
+    victim->used = true;
+
+    SDL_LockMutex(lock);
+    strcpy(queue[queueSize++], trackName);
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+    return NULL;
+}
+
+void art_pump(SDL_Renderer* renderer) {
+    if (worker == NULL) {
+        return;
+    }
+    ArtResult done[ART_UPLOADS_PER_FRAME];
+    SDL_LockMutex(lock);
+    const int n = resultCount < ART_UPLOADS_PER_FRAME ? resultCount : ART_UPLOADS_PER_FRAME;
+    memcpy(done, results, sizeof(ArtResult) * n);
+    memmove(results, results + n, sizeof(ArtResult) * (resultCount - n));
+    resultCount -= n;
+    SDL_UnlockMutex(lock);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < ART_CACHE_TEXTURES; j++) {
+            ArtEntry* e = &entries[j];
+            if (e->used && e->status == ART_LOADING && strcmp(e->key, done[i].key) == 0) {
+                e->texture = done[i].surface == NULL ? NULL : SDL_CreateTextureFromSurface(renderer, done[i].surface);
+                e->status = e->texture == NULL ? ART_NONE : ART_READY;
+                if (e->texture != NULL) {
+                    mem_add(MEM_TEXTURES, textureBytes(e->texture));
+                }
+                break;
+            }
+        }
+        SDL_FreeSurface(done[i].surface);
+    }
+    evictOverCap();
+}
+
+void art_quit() {
+    if (worker == NULL) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    quitting = true;
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+    SDL_WaitThread(worker, NULL);
+    worker = NULL;
+
+    for (int i = 0; i < resultCount; i++) {
+        SDL_FreeSurface(results[i].surface);
+    }
+    resultCount = 0;
+    queueSize = 0;
+    for (int i = 0; i < ART_CACHE_TEXTURES; i++) {
+        dropTexture(&entries[i]);
+        entries[i].used = false;
+    }
+    SDL_DestroyCond(wake);
+    SDL_DestroyMutex(lock);
+}
+
+bool art_isImageFile(const char* name) {
+    const char* dot = strrchr(name, '.');
+    if (dot == NULL) {
+        return false;
+    }
+    return strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0 || strcasecmp(dot, ".png") == 0;
+}
@@ -0,0 +1,25 @@
+//
+// Album art loading: embedded / folder covers are decoded on a worker thread,
+// downscaled to thumbnails, kept in an on-disk PNG cache and uploaded into a
+// small texture LRU from the main thread.
+//
+
+#ifndef ART_H
+#define ART_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+#define ART_THUMB_SIZE 240
+#define ART_CACHE_TEXTURES 24
+#define ART_QUEUE_MAX 32
+#define ART_UPLOADS_PER_FRAME 2
+#define ART_PATH_MAX 512
+
+bool art_init(const char* musicDir, const char* cacheDir);
+SDL_Texture* art_get(const char* trackName);
+void art_pump(SDL_Renderer* renderer);
+void art_quit();
+
+bool art_isImageFile(const char* name);
+#endif //ART_H
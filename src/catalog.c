@@ -0,0 +1,339 @@
+//
+// Song catalog, see catalog.h
+//
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "catalog.h"
+#include "mem.h"
+
+#include <stdlib.h>
+
+// buckets this small are insertion sorted instead of split further
+#define CATALOG_RUN 16
+
+static bool stripArticles = true;
+
+// U+00C0..U+00FF, × and ÷ are kept as they are
+static const char* latin1Fold[64] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", "\xc3\x97", "o", "u", "u", "u", "u", "y", "th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", "\xc3\xb7", "o", "u", "u", "u", "u", "y", "th", "y",
+};
+
+// U+0100..U+017F, one base letter each
+static const char latinExtAFold[129] =
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiiiiijjkkkllllllllllnnnnnnnnn"
+    "oooooooorrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+
+//KEYS
+static int articleLength(const char* p) {
+    static const char* articles[] = {"the ", "an ", "a "};
+    for (int i = 0; i < 3; i++) {
+        const size_t len = strlen(articles[i]);
+        if (strncasecmp(p, articles[i], len) == 0 && p[len] != '\0') {
+            return (int) len;
+        }
+    }
+    return 0;
+}
+
+// every path component is folded on its own so "The Beatles/..." and "x/The Beatles-..." both lose the article
+char* catalog_sortKey(const char* name) {
+    char* key = malloc(strlen(name) + 1); // a fold never outgrows its utf-8 sequence
+    char* out = key;
+    const unsigned char* p = (const unsigned char*) name;
+    bool componentStart = true;
+    while (*p) {
+        if (componentStart && stripArticles) {
+            p += articleLength((const char*) p);
+        }
+        componentStart = false;
+        const unsigned char c = *p;
+        if (c < 0x80) {
+            *out++ = (char) (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+            componentStart = c == '/';
+            p++;
+            continue;
+        }
+        if ((c & 0xe0) == 0xc0 && (p[1] & 0xc0) == 0x80) {
+            const unsigned cp = (unsigned) (c & 0x1f) << 6 | (p[1] & 0x3f);
+            if (cp >= 0xc0 && cp < 0x100) {
+                for (const char* f = latin1Fold[cp - 0xc0]; *f; f++) {
+                    *out++ = *f;
+                }
+                p += 2;
+                continue;
+            }
+            if (cp >= 0x100 && cp < 0x180) {
+                *out++ = latinExtAFold[cp - 0x100];
+                p += 2;
+                continue;
+            }
+        }
+        *out++ = (char) *p++; // anything else sorts by its raw bytes
+    }
+    *out = '\0';
+    return key;
+}
+
+static Uint64 keyPrefix(const char* key) {
+    Uint64 prefix = 0;
+    for (int i = 0; i < 8; i++) {
+        prefix <<= 8;
+        if (*key) {
+            prefix |= (unsigned char) *key++;
+        }
+    }
+    return prefix;
+}
+
+static long keyBytes(const Track* t) {
+    return (long) strlen(t->sortKey) + 1;
+}
+
+static Track makeTrack(const char* name) {
+    Track t;
+    t.name = strdup(name);
+    t.sortKey = catalog_sortKey(name);
+    t.prefix = keyPrefix(t.sortKey);
+    mem_add(MEM_CATALOG, (long) strlen(t.name) + 1 + keyBytes(&t));
+    return t;
+}
+
+static void freeTrack(const Track* t) {
+    mem_add(MEM_CATALOG, -((long) strlen(t->name) + 1 + keyBytes(t)));
+    free(t->name);
+    free(t->sortKey);
+}
+
+static int compareTracks(const Track* a, const Track* b) {
+    if (a->prefix != b->prefix) {
+        return a->prefix < b->prefix ? -1 : 1;
+    }
+    const int c = strcmp(a->sortKey, b->sortKey);
+    return c != 0 ? c : strcmp(a->name, b->name);
+}
+//END KEYS
+//SORTING
+static void insertionSort(Track* arr, const int lo, const int hi) {
+    for (int i = lo + 1; i < hi; i++) {
+        const Track t = arr[i];
+        int j = i - 1;
+        while (j >= lo && compareTracks(&t, &arr[j]) < 0) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = t;
+    }
+}
+
+// key byte at depth, the first 8 come from the packed prefix. radixSort only
+// recurses into keys that are longer than depth so the string read is in bounds
+static unsigned char keyByte(const Track* t, const int depth) {
+    if (depth < 8) {
+        return (unsigned char) (t->prefix >> (56 - 8 * depth));
+    }
+    return (unsigned char) t->sortKey[depth];
+}
+
+// MSD radix sort, one byte of key per level. buckets whose keys ran out are
+// equal keys and get ordered by name
+static void radixSort(Track* arr, Track* aux, const int lo, const int hi, const int depth) {
+    if (hi - lo <= CATALOG_RUN) {
+        insertionSort(arr, lo, hi);
+        return;
+    }
+    int count[257] = {0};
+    for (int i = lo; i < hi; i++) {
+        count[keyByte(&arr[i], depth) + 1]++;
+    }
+    for (int c = 0; c < 256; c++) {
+        count[c + 1] += count[c];
+    }
+    for (int i = lo; i < hi; i++) {
+        aux[lo + count[keyByte(&arr[i], depth)]++] = arr[i];
+    }
+    memcpy(arr + lo, aux + lo, sizeof(Track) * (hi - lo));
+    // count[c] now holds the end of bucket c
+    int start = lo;
+    for (int c = 0; c < 256; c++) {
+        const int end = lo + count[c];
+        if (end - start > 1) {
+            if (c == 0) {
+                insertionSort(arr, start, end);
+            } else {
+                radixSort(arr, aux, start, end, depth + 1);
+            }
+        }
+        start = end;
+    }
+}
+
+void catalog_sort(Catalog* catalog) {
+    if (catalog->size < 2) {
+        return;
+    }
+    Track* aux = malloc(sizeof(Track) * catalog->size);
+    radixSort(catalog->arr, aux, 0, catalog->size, 0);
+    free(aux);
+}
+//END SORTING
+
+Catalog* catalog_new(const int capacity) {
+    Catalog* catalog = malloc(sizeof(Catalog));
+    catalog->size = 0;
+    catalog->capacity = capacity > 0 ? capacity : 1;
+    catalog->arr = malloc(sizeof(Track) * catalog->capacity);
+    mem_add(MEM_CATALOG, (long) (sizeof(Catalog) + sizeof(Track) * catalog->capacity));
+    return catalog;
+}
+
+static void grow(Catalog* catalog) {
+    if (catalog->size >= catalog->capacity) {
+        mem_add(MEM_CATALOG, (long) (sizeof(Track) * catalog->capacity));
+        catalog->capacity *= 2;
+        catalog->arr = realloc(catalog->arr, sizeof(Track) * catalog->capacity);
+    }
+}
+
+// unsorted, for bulk loads that end with catalog_sort
+void catalog_append(Catalog* catalog, const char* name) {
+    grow(catalog);
+    catalog->arr[catalog->size++] = makeTrack(name);
+}
+
+static int search(const Catalog* catalog, const Track* t, bool* found) {
+    int lo = 0;
+    int hi = catalog->size;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        const int c = compareTracks(&catalog->arr[mid], t);
+        if (c == 0) {
+            *found = true;
+            return mid;
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+// index of name, or where it would be inserted when found is false
+int catalog_find(const Catalog* catalog, const char* name, bool* found) {
+    Track t;
+    t.name = (char*) name;
+    t.sortKey = catalog_sortKey(name);
+    t.prefix = keyPrefix(t.sortKey);
+    const int i = search(catalog, &t, found);
+    free(t.sortKey);
+    return i;
+}
+
+// sorted insert, -1 when the name is already there
+int catalog_insert(Catalog* catalog, const char* name) {
+    bool found;
+    Track t = makeTrack(name);
+    const int i = search(catalog, &t, &found);
+    if (found) {
+        freeTrack(&t);
+        return -1;
+    }
+    grow(catalog);
+    memmove(catalog->arr + i + 1, catalog->arr + i, sizeof(Track) * (catalog->size - i));
+    catalog->arr[i] = t;
+    catalog->size++;
+    return i;
+}
+
+void catalog_removeAt(Catalog* catalog, const int index) {
+    freeTrack(&catalog->arr[index]);
+    memmove(catalog->arr + index, catalog->arr + index + 1, sizeof(Track) * (catalog->size - index - 1));
+    catalog->size--;
+}
+
+// rebuilds every key and re-sorts, names (and pointers to them) stay valid
+void catalog_setStripArticles(Catalog* catalog, const bool strip) {
+    stripArticles = strip;
+    if (catalog == NULL) {
+        return;
+    }
+    for (int i = 0; i < catalog->size; i++) {
+        Track* t = &catalog->arr[i];
+        mem_add(MEM_CATALOG, -keyBytes(t));
+        free(t->sortKey);
+        t->sortKey = catalog_sortKey(t->name);
+        t->prefix = keyPrefix(t->sortKey);
+        mem_add(MEM_CATALOG, keyBytes(t));
+    }
+    catalog_sort(catalog);
+}
+
+void catalog_destroy(Catalog* catalog) {
+    if (catalog == NULL) {
+        return;
+    }
+    for (int i = 0; i < catalog->size; i++) {
+        freeTrack(&catalog->arr[i]);
+    }
+    mem_add(MEM_CATALOG, -(long) (sizeof(Catalog) + sizeof(Track) * catalog->capacity));
+    free(catalog->arr);
+    free(catalog);
+}
+
+//BENCHMARK
+// the old sort: plain strcmp over raw names
+static int cmpstr(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+void catalog_benchSort(const int count) {
+    static const char* artists[] = {
+        "The Beatles", "bladee", "Zebra", "\xc3\x89" "coute", "a-ha", "Bj\xc3\xb6rk", "The xx", "ABBA", "Sigur R\xc3\xb3s", "drain gang"
+    };
+    const int artistCount = sizeof(artists) / sizeof(artists[0]);
+    const int inserts = 1000;
+    const double freq = (double) SDL_GetPerformanceFrequency() / 1000.0;
+    char buf[128];
+    char** names = malloc(sizeof(char*) * count);
+    for (int i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "%s-Track %d.mp3", artists[rand() % artistCount], rand());
+        names[i] = strdup(buf);
+    }
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    Catalog* catalog = catalog_new(count);
+    for (int i = 0; i < count; i++) {
+        catalog_append(catalog, names[i]);
+    }
+    const Uint64 keyed = SDL_GetPerformanceCounter();
+    catalog_sort(catalog);
+    const Uint64 sorted = SDL_GetPerformanceCounter();
+    for (int i = 0; i < inserts; i++) {
+        snprintf(buf, sizeof(buf), "%s-New %d.mp3", artists[rand() % artistCount], rand());
+        catalog_insert(catalog, buf);
+    }
+    const Uint64 inserted = SDL_GetPerformanceCounter();
+
+    const Uint64 qsortStart = SDL_GetPerformanceCounter();
+    qsort(names, count, sizeof(char*), cmpstr);
+    const Uint64 qsorted = SDL_GetPerformanceCounter();
+
+    printf("%d tracks\n", count);
+    printf("qsort(cmpstr):    %8.2f ms\n", (double) (qsorted - qsortStart) / freq);
+    printf("build keys:       %8.2f ms\n", (double) (keyed - start) / freq);
+    printf("radix sort keys:  %8.2f ms\n", (double) (sorted - keyed) / freq);
+    printf("sorted insert:    %8.2f us each\n", (double) (inserted - sorted) / freq * 1000.0 / inserts);
+
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+    catalog_destroy(catalog);
+}
+//END BENCHMARK
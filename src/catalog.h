@@ -0,0 +1,38 @@
+//
+// Song catalog kept in collation order. Every track carries a precomputed sort
+// key (case folded, accents stripped, optionally without a leading "The "/"A ")
+// plus its first 8 key bytes packed into an integer so most comparisons never
+// touch the strings. New tracks are inserted in place, full sorts are MSD radix
+// sorts over the key bytes.
+//
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+typedef struct {
+    char* name; // relative to the music dir
+    char* sortKey;
+    Uint64 prefix;
+} Track;
+
+typedef struct {
+    int size;
+    int capacity;
+    Track* arr;
+} Catalog;
+
+Catalog* catalog_new(int capacity);
+void catalog_append(Catalog* catalog, const char* name);
+void catalog_sort(Catalog* catalog);
+int catalog_find(const Catalog* catalog, const char* name, bool* found);
+int catalog_insert(Catalog* catalog, const char* name);
+void catalog_removeAt(Catalog* catalog, int index);
+void catalog_setStripArticles(Catalog* catalog, bool strip);
+void catalog_destroy(Catalog* catalog);
+
+char* catalog_sortKey(const char* name);
+void catalog_benchSort(int count);
+#endif //CATALOG_H
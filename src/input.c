@@ -0,0 +1,70 @@
+//
+// Frame input, see input.h
+//
+#include "input.h"
+
+typedef struct {
+    SDL_Keysym ks;
+    Uint64 downTicks;
+} HeldKey;
+
+static InputPress presses[INPUT_MAX_PRESSES];
+static int pressCount = 0;
+static HeldKey held[INPUT_MAX_HELD];
+static int heldCount = 0;
+static bool chordHeld = false;
+
+void input_keyDown(const SDL_KeyboardEvent* e) {
+    if (e->repeat) {
+        return;
+    }
+    if (e->keysym.sym == INPUT_CHORD_KEY) {
+        chordHeld = true;
+        return;
+    }
+    if (pressCount < INPUT_MAX_PRESSES) {
+        presses[pressCount++] = (InputPress) {e->keysym, 1, false, chordHeld};
+    }
+    if (heldCount < INPUT_MAX_HELD) {
+        held[heldCount++] = (HeldKey) {e->keysym, SDL_GetTicks64()};
+    }
+}
+
+void input_keyUp(const SDL_KeyboardEvent* e) {
+    if (e->keysym.sym == INPUT_CHORD_KEY) {
+        chordHeld = false;
+        return;
+    }
+    for (int i = 0; i < heldCount; i++) {
+        if (held[i].ks.sym == e->keysym.sym) {
+            held[i] = held[--heldCount];
+            break;
+        }
+    }
+}
+
+// the key ups for anything held won't arrive once focus is gone
+void input_reset() {
+    heldCount = 0;
+    chordHeld = false;
+}
+
+// fresh presses in the order they came, then one repeat per key held past the delay.
+// the repeat step count goes up by one every repeatDelay ms, capped at maxSteps
+int input_poll(InputPress* out, const Uint64 now, const int repeatDelay, const int maxSteps) {
+    int n = 0;
+    for (int i = 0; i < pressCount; i++) {
+        out[n++] = presses[i];
+    }
+    pressCount = 0;
+    for (int i = 0; i < heldCount && n < INPUT_MAX_PRESSES; i++) {
+        const Uint64 heldFor = now - held[i].downTicks;
+        if (repeatDelay <= 0 || heldFor < (Uint64) repeatDelay) {
+            continue;
+        }
+        int steps = 1 + (int) ((heldFor - repeatDelay) / repeatDelay);
+        steps = steps > maxSteps ? maxSteps : steps;
+        out[n++] = (InputPress) {held[i].ks, steps, true, chordHeld};
+    }
+    return n;
+}
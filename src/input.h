@@ -0,0 +1,30 @@
+//
+// Key input collected over a frame. OS key repeat is ignored in favour of our
+// own hold-to-accelerate repeat: once a key has been held for the repeat delay
+// it fires every frame with a step count that grows with the hold time, so one
+// frame turns into one state change no matter how fast keys come in.
+// KP_ENTER is a chord modifier, keys pressed while it is held come out flagged.
+//
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+#define INPUT_MAX_PRESSES 32
+#define INPUT_MAX_HELD 8
+#define INPUT_CHORD_KEY SDLK_KP_ENTER
+
+typedef struct {
+    SDL_Keysym ks;
+    int steps;   // 1 for a press, grows while a held key repeats
+    bool repeat;
+    bool chord;  // INPUT_CHORD_KEY was held
+} InputPress;
+
+void input_keyDown(const SDL_KeyboardEvent* e);
+void input_keyUp(const SDL_KeyboardEvent* e);
+void input_reset();
+int input_poll(InputPress* out, Uint64 now, int repeatDelay, int maxSteps);
+#endif //INPUT_H
@@ -0,0 +1,118 @@
+//
+// Library index, see library.h
+// one "size\tmtime\tloudness\tname" line per track, appended as results come in
+// and compacted on save. later lines win when loading.
+//
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "library.h"
+#include "util.h"
+
+#include <stdlib.h>
+
+static Ek_Map* entries = NULL;
+static SDL_mutex* lock = NULL;
+static char indexPath[LIBRARY_LINE_MAX];
+
+static void putEntry(const char* name, const long long size, const long long mtime, const float loudness) {
+    LibraryEntry* e = map_get(entries, (char*) name);
+    if (e == NULL) {
+        e = malloc(sizeof(LibraryEntry));
+        e->name = strdup(name);
+        map_put(entries, e->name, e);
+    }
+    e->size = size;
+    e->mtime = mtime;
+    e->loudness = loudness;
+}
+
+bool library_load(const char* path) {
+    snprintf(indexPath, sizeof(indexPath), "%s", path);
+    entries = map_new(LIBRARY_BUCKETS);
+    lock = SDL_CreateMutex();
+    FILE* f = fopen(indexPath, "r");
+    if (f == NULL) {
+        return true; // first run, nothing indexed yet
+    }
+    char line[LIBRARY_LINE_MAX];
+    while (fgets(line, sizeof(line), f)) {
+        long long size = 0;
+        long long mtime = 0;
+        float loudness = 0;
+        int nameStart = 0;
+        if (sscanf(line, "%lld\t%lld\t%f\t%n", &size, &mtime, &loudness, &nameStart) < 3 || nameStart == 0) {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        putEntry(line + nameStart, size, mtime, loudness);
+    }
+    fclose(f);
+    return true;
+}
+
+float library_loudness(const char* name, const long long size, const long long mtime) {
+    if (entries == NULL) {
+        return LIBRARY_UNANALYZED;
+    }
+    SDL_LockMutex(lock);
+    const LibraryEntry* e = map_get(entries, (char*) name);
+    const float loudness = e != NULL && e->size == size && e->mtime == mtime ? e->loudness : LIBRARY_UNANALYZED;
+    SDL_UnlockMutex(lock);
+    return loudness;
+}
+
+void library_setLoudness(const char* name, const long long size, const long long mtime, const float loudness) {
+    if (entries == NULL) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    putEntry(name, size, mtime, loudness);
+    FILE* f = fopen(indexPath, "a");
+    if (f != NULL) {
+        fprintf(f, "%lld\t%lld\t%.2f\t%s\n", size, mtime, loudness, name);
+        fclose(f);
+    }
+    SDL_UnlockMutex(lock);
+}
+
+bool library_save() {
+    if (entries == NULL) {
+        return false;
+    }
+    char tmpPath[LIBRARY_LINE_MAX + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", indexPath);
+    SDL_LockMutex(lock);
+    FILE* f = fopen(tmpPath, "w");
+    if (f == NULL) {
+        SDL_UnlockMutex(lock);
+        printf("Failed to open library index for write\n");
+        return false;
+    }
+    for (int i = 0; i < entries->capacity; i++) {
+        for (const Ek_LinkedList* node = entries->mapArr[i]; node != NULL; node = node->next) {
+            const LibraryEntry* e = node->value;
+            fprintf(f, "%lld\t%lld\t%.2f\t%s\n", e->size, e->mtime, e->loudness, e->name);
+        }
+    }
+    fclose(f);
+    const bool ok = rename(tmpPath, indexPath) == 0;
+    SDL_UnlockMutex(lock);
+    return ok;
+}
+
+void library_quit() {
+    if (entries == NULL) {
+        return;
+    }
+    for (int i = 0; i < entries->capacity; i++) {
+        for (const Ek_LinkedList* node = entries->mapArr[i]; node != NULL; node = node->next) {
+            LibraryEntry* e = node->value;
+            free(e->name);
+            free(e);
+        }
+    }
+    map_destroy(entries);
+    entries = NULL;
+    SDL_DestroyMutex(lock);
+}
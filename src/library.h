@@ -0,0 +1,28 @@
+//
+// Library index: per-track data that is expensive to compute (loudness) kept in
+// a text file next to the config so every file is analyzed only once. Entries are
+// only trusted while the file's size and mtime still match.
+//
+
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "stdbool.h"
+
+#define LIBRARY_BUCKETS 1024
+#define LIBRARY_LINE_MAX 512
+#define LIBRARY_UNANALYZED (-1000.0f)
+
+typedef struct {
+    char* name;
+    long long size;
+    long long mtime;
+    float loudness; // integrated LUFS
+} LibraryEntry;
+
+bool library_load(const char* indexPath);
+float library_loudness(const char* name, long long size, long long mtime);
+void library_setLoudness(const char* name, long long size, long long mtime, float loudness);
+bool library_save();
+void library_quit();
+#endif //LIBRARY_H
@@ -0,0 +1,382 @@
+//
+// EBU R128 loudness, see loudness.h
+//
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL_mixer.h>
+#include "sys/stat.h"
+#include "loudness.h"
+#include "library.h"
+#include "util.h"
+#include "mem.h"
+
+#include <stdlib.h>
+
+#define LOUDNESS_PATH_MAX 512
+
+// left/right run through the filters side by side, one lane each (SSE2 / NEON)
+typedef double v2d __attribute__((vector_size(16)));
+
+typedef struct {
+    double b0, b1, b2, a1, a2;
+} Biquad;
+
+static char musicDir[LOUDNESS_PATH_MAX];
+static int rate = MIX_DEFAULT_FREQUENCY;
+static int channels = 2;
+
+static SDL_Thread* worker = NULL;
+static SDL_mutex* lock = NULL;
+static SDL_cond* wake = NULL;
+static bool quitting = false;
+static Ek_List* queue = NULL;
+static SDL_atomic_t generation;
+
+//ANALYSIS
+// K-weighting pre-filter (shelf + RLB high pass), coefficients derived for any rate
+static void kWeighting(const int sampleRate, Biquad* shelf, Biquad* highpass) {
+    double f0 = 1681.974450955533;
+    const double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / sampleRate);
+    const double vh = pow(10.0, gain / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf->b0 = (vh + vb * k / q + k * k) / a0;
+    shelf->b1 = 2.0 * (k * k - vh) / a0;
+    shelf->b2 = (vh - vb * k / q + k * k) / a0;
+    shelf->a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf->a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    highpass->b0 = 1.0;
+    highpass->b1 = -2.0;
+    highpass->b2 = 1.0;
+    highpass->a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass->a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static v2d splat(const double v) {
+    const v2d r = {v, v};
+    return r;
+}
+
+// interleaved S16 in, integrated loudness in LUFS out
+float loudness_integrated(const Sint16* samples, const int frames, const int chans, const int sampleRate) {
+    Biquad shelf;
+    Biquad highpass;
+    kWeighting(sampleRate, &shelf, &highpass);
+    const v2d sb0 = splat(shelf.b0), sb1 = splat(shelf.b1), sb2 = splat(shelf.b2);
+    const v2d sa1 = splat(shelf.a1), sa2 = splat(shelf.a2);
+    const v2d hb0 = splat(highpass.b0), hb1 = splat(highpass.b1), hb2 = splat(highpass.b2);
+    const v2d ha1 = splat(highpass.a1), ha2 = splat(highpass.a2);
+    const v2d scale = splat(1.0 / 32768.0);
+    v2d s1 = splat(0), s2 = splat(0), h1 = splat(0), h2 = splat(0);
+
+    // mean square per 100ms sub-block, 400ms gating blocks are 4 consecutive ones
+    const int step = sampleRate / 10;
+    const int subCount = step > 0 ? frames / step : 0;
+    if (subCount < 4) {
+        return LOUDNESS_SILENT;
+    }
+    double* sub = malloc(sizeof(double) * subCount);
+    const int right = chans > 1 ? 1 : 0;
+    const v2d mask = {1.0, chans > 1 ? 1.0 : 0.0};
+    for (int b = 0; b < subCount; b++) {
+        v2d acc = splat(0);
+        const Sint16* in = samples + (size_t) b * step * chans;
+        for (int i = 0; i < step; i++, in += chans) {
+            const v2d raw = {in[0], in[right]};
+            const v2d x = raw * scale * mask;
+            const v2d y = sb0 * x + s1;
+            s1 = sb1 * x - sa1 * y + s2;
+            s2 = sb2 * x - sa2 * y;
+            const v2d z = hb0 * y + h1;
+            h1 = hb1 * y - ha1 * z + h2;
+            h2 = hb2 * y - ha2 * z;
+            acc += z * z;
+        }
+        sub[b] = (acc[0] + acc[1]) / step;
+    }
+
+    const double absGate = pow(10.0, (LOUDNESS_SILENT + 0.691) / 10.0);
+    double sum = 0;
+    int count = 0;
+    for (int b = 0; b + 3 < subCount; b++) {
+        const double z = (sub[b] + sub[b + 1] + sub[b + 2] + sub[b + 3]) / 4;
+        if (z > absGate) {
+            sum += z;
+            count++;
+        }
+    }
+    float loudness = LOUDNESS_SILENT;
+    if (count > 0) {
+        const double relGate = sum / count / 10.0; // -10 LU
+        sum = 0;
+        count = 0;
+        for (int b = 0; b + 3 < subCount; b++) {
+            const double z = (sub[b] + sub[b + 1] + sub[b + 2] + sub[b + 3]) / 4;
+            if (z > absGate && z > relGate) {
+                sum += z;
+                count++;
+            }
+        }
+        loudness = (float) (-0.691 + 10.0 * log10(sum / count));
+    }
+    free(sub);
+    return loudness;
+}
+
+float loudness_gainDb(const float loudness) {
+    if (loudness <= LOUDNESS_SILENT) {
+        return 0; // unanalyzed or silent, leave it alone
+    }
+    const float gain = LOUDNESS_TARGET - loudness;
+    return gain > LOUDNESS_MAX_BOOST ? LOUDNESS_MAX_BOOST : gain < LOUDNESS_MAX_CUT ? LOUDNESS_MAX_CUT : gain;
+}
+//END ANALYSIS
+//WORKER
+static double totalAudio = 0;
+static double totalCpu = 0;
+static int totalTracks = 0;
+
+// decoded 16-bit 44.1kHz stereo is ~44x a 32kbps mp3 or opus, files small enough for that
+// to stay under the limit skip the duration probe; anything coarser still gets probed
+#define LOUDNESS_MAX_EXPANSION 48
+
+// read only window over the first limit bytes of a file, decoders see a short file
+typedef struct {
+    SDL_RWops* file;
+    Sint64 limit;
+} Prefix;
+
+static Sint64 prefixSize(SDL_RWops* rw) {
+    return ((Prefix*) rw->hidden.unknown.data1)->limit;
+}
+
+static Sint64 prefixSeek(SDL_RWops* rw, const Sint64 offset, const int whence) {
+    const Prefix* p = rw->hidden.unknown.data1;
+    Sint64 target = offset;
+    if (whence == RW_SEEK_CUR) {
+        target += SDL_RWtell(p->file);
+    } else if (whence == RW_SEEK_END) {
+        target += p->limit;
+    }
+    if (target < 0) {
+        return SDL_SetError("Seek before start of file");
+    }
+    return SDL_RWseek(p->file, target < p->limit ? target : p->limit, RW_SEEK_SET);
+}
+
+static size_t prefixRead(SDL_RWops* rw, void* ptr, const size_t size, size_t num) {
+    const Prefix* p = rw->hidden.unknown.data1;
+    const Sint64 left = p->limit - SDL_RWtell(p->file);
+    if (size == 0 || left <= 0) {
+        return 0;
+    }
+    if ((Sint64) (size * num) > left) {
+        num = (size_t) left / size;
+    }
+    return SDL_RWread(p->file, ptr, size, num);
+}
+
+static size_t prefixWrite(SDL_RWops* rw, const void* ptr, const size_t size, const size_t num) {
+    return 0;
+}
+
+static int prefixClose(SDL_RWops* rw) {
+    Prefix* p = rw->hidden.unknown.data1;
+    const int result = SDL_RWclose(p->file);
+    free(p);
+    SDL_FreeRW(rw);
+    return result;
+}
+
+static SDL_RWops* prefixFromFile(SDL_RWops* file, const Sint64 limit) {
+    SDL_RWops* rw = SDL_AllocRW();
+    if (rw == NULL) {
+        SDL_RWclose(file);
+        return NULL;
+    }
+    Prefix* p = malloc(sizeof(Prefix));
+    p->file = file;
+    p->limit = limit;
+    rw->size = prefixSize;
+    rw->seek = prefixSeek;
+    rw->read = prefixRead;
+    rw->write = prefixWrite;
+    rw->close = prefixClose;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = p;
+    return rw;
+}
+
+// most decoded bytes one analysis may hold, the duration cap or the audio budget
+static long decodeLimit() {
+    const long limit = (long) LOUDNESS_MAX_SECONDS * rate * channels * (long) sizeof(Sint16);
+    return mem_cap(MEM_AUDIO) != 0 && mem_cap(MEM_AUDIO) < limit ? mem_cap(MEM_AUDIO) : limit;
+}
+
+// the file to decode, cut down to roughly decodeLimit() of audio when the track is longer.
+// the duration probe only runs for files big enough to possibly need it
+static SDL_RWops* openForAnalysis(const char* path, const long long fileSize) {
+    SDL_RWops* file = SDL_RWFromFile(path, "rb");
+    const long limit = decodeLimit();
+    if (file == NULL || fileSize * LOUDNESS_MAX_EXPANSION <= limit) {
+        return file;
+    }
+    Mix_Music* music = Mix_LoadMUS(path);
+    const double seconds = music == NULL ? 0 : Mix_MusicDuration(music);
+    Mix_FreeMusic(music);
+    if (seconds <= 0) {
+        // unknown length, only take as much file as the worst case expansion allows
+        return prefixFromFile(file, limit / LOUDNESS_MAX_EXPANSION);
+    }
+    const double bytes = seconds * rate * channels * sizeof(Sint16);
+    if (bytes <= limit) {
+        return file;
+    }
+    return prefixFromFile(file, (Sint64) ((double) fileSize * limit / bytes));
+}
+
+static bool analyzeTrack(const char* name) {
+    char path[LOUDNESS_PATH_MAX * 2];
+    struct stat filestat;
+    snprintf(path, sizeof(path), "%s/%s", musicDir, name);
+    if (stat(path, &filestat) == -1) {
+        return false;
+    }
+    if (library_loudness(name, filestat.st_size, filestat.st_mtime) != LIBRARY_UNANALYZED) {
+        return false;
+    }
+    const double freq = (double) SDL_GetPerformanceFrequency();
+    const Uint64 start = SDL_GetPerformanceCounter();
+    SDL_RWops* rw = openForAnalysis(path, filestat.st_size);
+    Mix_Chunk* chunk = rw == NULL ? NULL : Mix_LoadWAV_RW(rw, 1);
+    if (chunk == NULL) {
+        SDL_Log("Failed to decode %s for loudness\nSDL_Error: %s", path, SDL_GetError());
+        // remember it so it isn't decoded again every boot and play, silent means no gain
+        library_setLoudness(name, filestat.st_size, filestat.st_mtime, LOUDNESS_SILENT);
+        return false;
+    }
+    mem_add(MEM_AUDIO, chunk->alen);
+    const int frames = (int) (chunk->alen / (sizeof(Sint16) * channels));
+    const Uint64 decoded = SDL_GetPerformanceCounter();
+    const float loudness = loudness_integrated((const Sint16*) chunk->abuf, frames, channels, rate);
+    const Uint64 end = SDL_GetPerformanceCounter();
+    mem_add(MEM_AUDIO, -(long) chunk->alen);
+    Mix_FreeChunk(chunk);
+    library_setLoudness(name, filestat.st_size, filestat.st_mtime, loudness);
+
+    const double audio = (double) frames / rate;
+    totalAudio += audio;
+    totalCpu += (double) (end - start) / freq;
+    totalTracks++;
+    SDL_Log("loudness %s: %.1f LUFS, %.0fs audio/s (filter only %.0fs audio/s)", name, loudness,
+            audio * freq / (double) (end - start), audio * freq / (double) (end - decoded + 1));
+    return true;
+}
+
+static int loudnessWorker(void* data) {
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    SDL_LockMutex(lock);
+    while (!quitting) {
+        if (queue->size == 0) {
+            if (totalTracks > 0) {
+                SDL_Log("loudness scan: %d tracks, %.0fs audio in %.1fs, %.0fs audio/s", totalTracks, totalAudio, totalCpu,
+                        totalCpu > 0 ? totalAudio / totalCpu : 0);
+                totalTracks = 0;
+                totalAudio = 0;
+                totalCpu = 0;
+            }
+            SDL_CondWait(wake, lock);
+            continue;
+        }
+        // newest first so the track that just started playing jumps the line
+        char* name = queue->arr[--queue->size];
+        SDL_UnlockMutex(lock);
+        if (analyzeTrack(name)) {
+            SDL_AtomicAdd(&generation, 1);
+        }
+        free(name);
+        SDL_LockMutex(lock);
+    }
+    SDL_UnlockMutex(lock);
+    return 0;
+}
+//END WORKER
+
+bool loudness_init(const char* music) {
+    Uint16 format = 0;
+    snprintf(musicDir, sizeof(musicDir), "%s", music);
+    // a wav cut short by openForAnalysis still decodes up to the cut
+    SDL_SetHint(SDL_HINT_WAVE_TRUNCATION, "dropblock");
+    if (Mix_QuerySpec(&rate, &format, &channels) == 0 || format != AUDIO_S16SYS || channels < 1) {
+        SDL_Log("Loudness needs an open S16 audio device, normalization disabled");
+        return false;
+    }
+    queue = list_new(64);
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    quitting = false;
+    worker = SDL_CreateThread(loudnessWorker, "loudness", NULL);
+    if (worker == NULL) {
+        SDL_Log("Failed to start loudness worker!\nSDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void loudness_enqueue(const char* trackName) {
+    if (worker == NULL) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    list_add(queue, strdup(trackName));
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+}
+
+// bumped whenever a track's loudness lands in the library
+int loudness_generation() {
+    return SDL_AtomicGet(&generation);
+}
+
+void loudness_quit() {
+    if (worker == NULL) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    quitting = true;
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+    SDL_WaitThread(worker, NULL);
+    worker = NULL;
+    for (int i = 0; i < queue->size; i++) {
+        free(queue->arr[i]);
+    }
+    free(queue->arr);
+    free(queue);
+    queue = NULL;
+    SDL_DestroyCond(wake);
+    SDL_DestroyMutex(lock);
+}
+
+// seconds of audio measured per second of cpu, stereo noise at the default rate
+double loudness_bench(const int seconds) {
+    const int frames = seconds * MIX_DEFAULT_FREQUENCY;
+    Sint16* samples = malloc(sizeof(Sint16) * 2 * frames);
+    for (int i = 0; i < frames * 2; i++) {
+        samples[i] = (Sint16) (rand() % 16384 - 8192);
+    }
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const float loudness = loudness_integrated(samples, frames, 2, MIX_DEFAULT_FREQUENCY);
+    const Uint64 end = SDL_GetPerformanceCounter();
+    free(samples);
+    printf("loudness of noise: %.1f LUFS\n", loudness);
+    return seconds * (double) SDL_GetPerformanceFrequency() / (double) (end - start + 1);
+}
@@ -0,0 +1,29 @@
+//
+// EBU R128 integrated loudness. A background worker decodes tracks that are not
+// in the library index yet, measures them and stores the result there; playback
+// turns the stored loudness into a per-track gain.
+//
+
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+#define LOUDNESS_TARGET (-18.0f)
+#define LOUDNESS_MAX_BOOST 6.0f
+#define LOUDNESS_MAX_CUT (-12.0f)
+#define LOUDNESS_SILENT (-70.0f)
+// tracks are decoded whole for analysis, longer ones are measured on their
+// first LOUDNESS_MAX_SECONDS (about 100 MB of 44.1k stereo)
+#define LOUDNESS_MAX_SECONDS 600
+
+bool loudness_init(const char* musicDir);
+void loudness_enqueue(const char* trackName);
+int loudness_generation();
+void loudness_quit();
+
+float loudness_integrated(const Sint16* samples, int frames, int channels, int rate);
+float loudness_gainDb(float loudness);
+double loudness_bench(int seconds);
+#endif //LOUDNESS_H
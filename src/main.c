@@ -4,26 +4,42 @@
 #include <SDL_mixer.h>
 #include <sys/errno.h>
 #include <unistd.h>
+#include <math.h>
 
 #include "dirent.h"
 #include "sys/stat.h"
 #include "stdbool.h"
 #include "util.h"
+#include "art.h"
+#include "spectrum.h"
+#include "library.h"
+#include "loudness.h"
+#include "watch.h"
+#include "catalog.h"
+#include "input.h"
+#include "mem.h"
+#include "snapshot.h"
+#include "scan.h"
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 480;
 const int FRAME_RATE = 16;
 const int TICKS_PER_FRAME = 1000 / FRAME_RATE;
-const int MAX_SONGS = 100;
 const int ITEMS_PER_PAGE = 9;
-const int MAX_FILE_NAME = 240;
+const int MAX_FILE_NAME = 240; // song names are relative to resourceDir, MAX_FILE_NAME * 2 fits both
 const int VOLUME_STEP = 4;
+const int GLYPH_ATLAS_WIDTH = 1024;
+const double BOOT_BUDGET_MS = 500;
 const char* resourceDir = "/Users/evankelch/Library/Application Support/mp/resources";
 const char* fontsDir = "/Users/evankelch/Library/Application Support/mp/fonts";
 const char* configPath = "/Users/evankelch/Library/Application Support/mp/config/config.txt";
-char* songsArr[MAX_SONGS];
-int songCount = 0;
+const char* libraryPath = "/Users/evankelch/Library/Application Support/mp/config/library.txt";
+const char* artCacheDir = "/Users/evankelch/Library/Application Support/mp/cache/art";
+const char* cacheDir = "/Users/evankelch/Library/Application Support/mp/cache";
+const char* snapshotPath = "/Users/evankelch/Library/Application Support/mp/cache/snapshot.txt";
+Catalog* songs = NULL;
 char* fontFiles[9];
+int fontCount = 0;
 
 const SDL_Color fontColor = {255, 172, 28, 255};
 const SDL_Color selectedFontColor = {130, 233, 211, 255};
@@ -48,6 +64,11 @@ typedef enum {
     DEBUG_FONT,
     DEBUG_FONT_SIZE,
     DEBUG_LINE_SPACE,
+    DEBUG_REPLAY_GAIN,
+    DEBUG_SORT_ARTICLES,
+    DEBUG_REPEAT_DELAY,
+    DEBUG_REPEAT_MAX,
+    DEBUG_MEM_BUDGET,
     DEBUG_PROPERTY_COUNT
 } DebugOption;
 
@@ -57,6 +78,7 @@ typedef enum {
     MENU_ARTISTS,
     MENU_PLAYLISTS,
     MENU_ALL_SONGS,
+    MENU_NOW_PLAYING,
     MENU_PROP_COUNT
 } MenuState;
 
@@ -67,11 +89,13 @@ typedef struct {
     DebugOption selectedDebug;
     bool optionsOpen;
     int volume;
+    int songIndex;
+    bool muted;
 } State;
 
 char* menuTexts[] = {
     "Welcome\n\nPress any key to enter",
-    "1. Artists\n2. Playlists\n3. All songs",
+    "1. Artists\n2. Playlists\n3. All songs\n4. Now playing",
     "0. Back\n1. Nikitata\n2. Bladee\n",
     "0. Back\n1. Playlist 1\n2. Playlist 2\n",
 };
@@ -79,12 +103,15 @@ char* menuTexts[] = {
 SDL_Window* gWindow = NULL;
 SDL_Renderer* gRenderer = NULL;
 TTF_Font* dFont = NULL;
-State state = {{0,0,0,0}, 0, 0, 0,false,40};
+State state = {{0,0,0,0}, 0, 0, 0,false,40,-1,false};
 Mix_Music* gMusic = NULL;
 int linePos = 0;
 LDebugOption debugOptions[DEBUG_PROPERTY_COUNT];
-LTexture textureMap[255];
+LTexture glyphAtlas = {NULL, {0, 0, 0, 0}};
+SDL_Rect glyphRects[256];
+SDL_Surface* glyphAtlasSurface = NULL; // built this run and not written to disk yet
 Ek_Map* artistMap;
+float songGainDb = 0;
 
 //DEBUG OPTIONS SETUP
 void updDebug(const int index, const char* description, const int value, const int min, const int max) {
@@ -101,11 +128,16 @@ void populateDebugOptions() {
     updDebug(DEBUG_FONT, "font", 0, 0, 1);
     updDebug(DEBUG_FONT_SIZE, "font size", 24, 6, 64);
     updDebug(DEBUG_LINE_SPACE, "line space", 24, 6, 64);
+    updDebug(DEBUG_REPLAY_GAIN, "replaygain", 1, 0, 1);
+    updDebug(DEBUG_SORT_ARTICLES, "skip the", 1, 0, 1);
+    updDebug(DEBUG_REPEAT_DELAY, "repeat ms", 400, 50, 1000);
+    updDebug(DEBUG_REPEAT_MAX, "repeat max", 8, 1, 32);
+    updDebug(DEBUG_MEM_BUDGET, "mem mb", 0, 0, 512);
 }
 
 //CONFIG
 void writeToConfig() {
-    char configBuf[1024];
+    char configBuf[1024] = "";
     for (int i = 0; i < DEBUG_PROPERTY_COUNT; i++) {
         char lineBuf[32];
         sprintf(lineBuf, "%s=%d\n", debugOptions[i].description, debugOptions[i].value);
@@ -148,13 +180,18 @@ void readConfigFile() {
 void scanFontDir() {
     DIR* dirp = opendir(fontsDir);
     struct dirent* entry;
-    int i = 0;
-    while ((entry = readdir(dirp))) {
+    const int maxFonts = sizeof(fontFiles) / sizeof(fontFiles[0]);
+    if (dirp == NULL) {
+        printf("Unable to read dir %s\n", fontsDir);
+        return;
+    }
+    while ((entry = readdir(dirp)) && fontCount < maxFonts) {
         if (entry->d_name[0] != '.') {
-            fontFiles[i++] = entry->d_name;
+            fontFiles[fontCount++] = strdup(entry->d_name);
         }
     }
-    debugOptions[DEBUG_FONT].max = i - 1;
+    closedir(dirp);
+    debugOptions[DEBUG_FONT].max = fontCount - 1;
 }
 
 bool loadFont() {
@@ -169,25 +206,122 @@ bool loadFont() {
     return true;
 }
 
+void glyphAtlasPath(char* out, const int size) {
+    snprintf(out, size, "%s/glyphs-%d-%s.png", cacheDir, debugOptions[DEBUG_FONT_SIZE].value, fontFiles[debugOptions[DEBUG_FONT].value]);
+}
+
+long glyphAtlasBytes() {
+    const long bytes = (long) glyphAtlas.renderQuad.w * glyphAtlas.renderQuad.h * 4;
+    return glyphAtlasSurface != NULL ? bytes * 2 : bytes;
+}
+
+void clearFontTextureMap() {
+    mem_add(MEM_GLYPHS, -glyphAtlasBytes());
+    if (glyphAtlas.sdlTexture != NULL) {
+        SDL_DestroyTexture(glyphAtlas.sdlTexture);
+    }
+    SDL_FreeSurface(glyphAtlasSurface);
+    glyphAtlas.sdlTexture = NULL;
+    glyphAtlas.renderQuad = (SDL_Rect) {0, 0, 0, 0};
+    glyphAtlasSurface = NULL;
+}
+
+bool useGlyphAtlas(SDL_Surface* atlas) {
+    glyphAtlas.sdlTexture = SDL_CreateTextureFromSurface(gRenderer, atlas);
+    if (glyphAtlas.sdlTexture == NULL) {
+        printf("Failed to texture glyph atlas");
+        return false;
+    }
+    glyphAtlas.renderQuad = (SDL_Rect) {0, 0, atlas->w, atlas->h};
+    return true;
+}
+
+// written once per font and size, boot loads it back instead of rasterizing
+void saveGlyphAtlas() {
+    if (glyphAtlasSurface == NULL) {
+        return;
+    }
+    char path[512];
+    glyphAtlasPath(path, sizeof(path));
+    if (IMG_SavePNG(glyphAtlasSurface, path) != 0) {
+        SDL_Log("Failed to save glyph atlas %s\nSDL_Error: %s", path, SDL_GetError());
+    }
+    mem_add(MEM_GLYPHS, -glyphAtlasBytes());
+    SDL_FreeSurface(glyphAtlasSurface);
+    glyphAtlasSurface = NULL;
+    mem_add(MEM_GLYPHS, glyphAtlasBytes());
+}
+
+// every printable glyph packed into rows of one texture, text is drawn from it with src rects
 bool loadFontTextureMap() {
-    const char* chars = " qwertyuiopasdfghjklzxcvbnmQWERTYUIOPASDFGHJKLZXCVBNM1234567890!@#$%^&*()_+-=,./:;'[]{}";
-    for (int i = 0; i < strlen(chars); i++) {
-        SDL_Surface* surface = TTF_RenderGlyph_Solid(dFont, chars[i], fontColor);
-        if (surface == NULL) {
-            printf("Failed to surface %d", chars[i]);
-            return false;
+    SDL_Surface* glyphs[256] = {NULL};
+    int x = 0;
+    int y = 0;
+    int rowHeight = 0;
+    clearFontTextureMap();
+    memset(glyphRects, 0, sizeof(glyphRects));
+    for (int c = ' '; c <= '~'; c++) {
+        glyphs[c] = TTF_RenderGlyph_Solid(dFont, c, fontColor);
+        if (glyphs[c] == NULL) {
+            printf("Failed to surface %d", c);
+            continue;
+        }
+        if (x + glyphs[c]->w > GLYPH_ATLAS_WIDTH) {
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
         }
-        SDL_Texture* sdlTexture = SDL_CreateTextureFromSurface(gRenderer, surface);
-        if (sdlTexture == NULL) {
-            printf("Failed to texture %d", chars[i]);
-            return false;
+        glyphRects[c] = (SDL_Rect) {x, y, glyphs[c]->w, glyphs[c]->h};
+        x += glyphs[c]->w;
+        rowHeight = glyphs[c]->h > rowHeight ? glyphs[c]->h : rowHeight;
+    }
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_WIDTH, y + rowHeight, 32, SDL_PIXELFORMAT_RGBA32);
+    for (int c = ' '; c <= '~'; c++) {
+        if (glyphs[c] != NULL && atlas != NULL) {
+            SDL_Rect dst = glyphRects[c];
+            SDL_BlitSurface(glyphs[c], NULL, atlas, &dst);
         }
-        SDL_Rect renderQuad = {0,0,surface->w, surface->h};
-        LTexture lTexture = {sdlTexture, renderQuad};
-        textureMap[chars[i]] = lTexture;
+        SDL_FreeSurface(glyphs[c]);
+    }
+    if (atlas == NULL || !useGlyphAtlas(atlas)) {
+        SDL_FreeSurface(atlas);
+        return false;
+    }
+    glyphAtlasSurface = atlas;
+    mem_add(MEM_GLYPHS, glyphAtlasBytes());
+    // the cpu copy only waits around for shutdown, under a tight budget write it out now
+    if (mem_overCap(MEM_GLYPHS)) {
+        saveGlyphAtlas();
     }
     return true;
 }
+
+// usable only while the configured font and size are the ones it was built from
+bool loadSnapshotGlyphAtlas(const Snapshot* snapshot) {
+    const int font = debugOptions[DEBUG_FONT].value;
+    if (font < 0 || font >= fontCount || strcmp(snapshot->font, fontFiles[font]) != 0 ||
+        snapshot->fontSize != debugOptions[DEBUG_FONT_SIZE].value) {
+        return false;
+    }
+    char path[512];
+    glyphAtlasPath(path, sizeof(path));
+    SDL_Surface* atlas = IMG_Load(path);
+    if (atlas == NULL) {
+        return false;
+    }
+    const bool ok = useGlyphAtlas(atlas);
+    SDL_FreeSurface(atlas);
+    if (ok) {
+        memcpy(glyphRects, snapshot->glyphs, sizeof(glyphRects));
+        mem_add(MEM_GLYPHS, glyphAtlasBytes());
+    }
+    return ok;
+}
+
+// the font itself is only opened once the atlas has to be rebuilt
+bool reloadFont() {
+    return loadFont() && loadFontTextureMap();
+}
 //END FONTS
 //STATE
 MenuState getMenuState() {
@@ -220,21 +354,23 @@ MenuState popMenuState() {
 //RENDERING
 void renderTextWithColor(const int x, const int y, const char* text, const SDL_Color color) {
     SDL_Rect renderQuad = {x,y,0,0};
+    if (color.a != 0) {
+        SDL_SetTextureColorMod(glyphAtlas.sdlTexture, color.r, color.g, color.b);
+    } else {
+        SDL_SetTextureColorMod(glyphAtlas.sdlTexture, fontColor.r, fontColor.g, fontColor.b);
+    }
     for (int i = 0; i < strlen(text); i++) {
         if (text[i] == '\n') {
             renderQuad.x = x;
             renderQuad.y += debugOptions[DEBUG_FONT_SIZE].value;
         } else {
-            const LTexture lTexture = textureMap[text[i]];
-            if (color.a != 0) {
-                SDL_SetTextureColorMod(lTexture.sdlTexture, color.r, color.g, color.b);
-            } else {
-                SDL_SetTextureColorMod(lTexture.sdlTexture, fontColor.r, fontColor.g, fontColor.b);
+            const SDL_Rect* glyph = &glyphRects[(unsigned char) text[i]];
+            if (glyph->w > 0) {
+                renderQuad.w = glyph->w;
+                renderQuad.h = glyph->h;
+                SDL_RenderCopy(gRenderer, glyphAtlas.sdlTexture, glyph, &renderQuad);
             }
-            renderQuad.w = lTexture.renderQuad.w;
-            renderQuad.h = lTexture.renderQuad.h;
-            SDL_RenderCopy(gRenderer, lTexture.sdlTexture, NULL, &renderQuad);
-            renderQuad.x += lTexture.renderQuad.w;
+            renderQuad.x += glyph->w;
         }
     }
 }
@@ -244,36 +380,111 @@ void renderText(const int x, const int y, const char* text) {
 }
 
 void renderSongsPage() {
-    char lineText[MAX_FILE_NAME] = "";
-    sprintf(lineText, "0. Back   Page: %d/%d   Previous Page: (/)   Next Page: (*)\n\n", state.pageIndex, songCount / ITEMS_PER_PAGE);
+    char lineText[MAX_FILE_NAME + 16] = "";
+    snprintf(lineText, sizeof(lineText), "0. Back   Page: %d/%d   Previous Page: (/)   Next Page: (*)\n\n", state.pageIndex, songs->size / ITEMS_PER_PAGE);
     renderText(0,0,lineText);
     for (int i = 0; i < ITEMS_PER_PAGE; i++) {
-        sprintf(lineText, "%d. %s\n", i + 1, songsArr[i + state.pageIndex * ITEMS_PER_PAGE]);
+        if (i + state.pageIndex * ITEMS_PER_PAGE >= songs->size) {
+            break;
+        }
+        snprintf(lineText, sizeof(lineText), "%d. %s\n", i + 1, songs->arr[i + state.pageIndex * ITEMS_PER_PAGE].name);
         renderText(0,debugOptions[DEBUG_LINE_SPACE].value * (i + 2), lineText);
     }
 }
 
 void renderArtistsPage() {
-    char lineText[MAX_FILE_NAME] = "";
-    sprintf(lineText, "0. Back   Page: %d/%d   Previous Page: (/)   Next Page: (*)\n\n", state.pageIndex, songCount / ITEMS_PER_PAGE);
+    char lineText[MAX_FILE_NAME + 16] = "";
+    snprintf(lineText, sizeof(lineText), "0. Back   Page: %d/%d   Previous Page: (/)   Next Page: (*)\n\n", state.pageIndex, songs->size / ITEMS_PER_PAGE);
     renderText(0,0,lineText);
     int keycount = 0;
     char** keys = map_keys(artistMap, &keycount);
+    const int lineSpace = debugOptions[DEBUG_LINE_SPACE].value;
     for (int i = 0; i < ITEMS_PER_PAGE; i++) {
         if (i + state.pageIndex * ITEMS_PER_PAGE >= keycount) {
             break;
         }
-        sprintf(lineText, "%d. %s\n", i + 1, keys[i + state.pageIndex * ITEMS_PER_PAGE]);
-        renderText(0,debugOptions[DEBUG_LINE_SPACE].value * (i + 2), lineText);
+        char* artist = keys[i + state.pageIndex * ITEMS_PER_PAGE];
+        // artist art comes from their first track, drawn once the worker has it
+        const Ek_List* tracks = map_get(artistMap, artist);
+        SDL_Texture* art = tracks != NULL && tracks->size > 0 ? art_get(tracks->arr[0]) : NULL;
+        if (art != NULL) {
+            const SDL_Rect artQuad = {0, lineSpace * (i + 2), lineSpace, lineSpace};
+            SDL_RenderCopy(gRenderer, art, NULL, &artQuad);
+        }
+        snprintf(lineText, sizeof(lineText), "%d. %s\n", i + 1, artist);
+        renderText(lineSpace + 4,lineSpace * (i + 2), lineText);
     }
     free(keys);
 }
 
+void formatTime(char* buf, const double seconds) {
+    const int s = seconds > 0 ? (int) seconds : 0;
+    sprintf(buf, "%d:%02d", s / 60, s % 60);
+}
+
+void renderSpectrum(const SDL_Rect area) {
+    float levels[SPECTRUM_BARS];
+    if (!spectrum_read(levels)) {
+        return;
+    }
+    // one batched fill for the whole bar region
+    SDL_Rect quads[SPECTRUM_BARS];
+    const int gap = 2;
+    const int w = area.w / SPECTRUM_BARS;
+    for (int i = 0; i < SPECTRUM_BARS; i++) {
+        const int h = (int) (levels[i] * (float) area.h);
+        quads[i] = (SDL_Rect) {area.x + i * w, area.y + area.h - h, w - gap, h};
+    }
+    SDL_SetRenderDrawColor(gRenderer, fontColor.r, fontColor.g, fontColor.b, 255);
+    SDL_RenderFillRects(gRenderer, quads, SPECTRUM_BARS);
+}
+
+void renderNowPlayingPage() {
+    const int lineSpace = debugOptions[DEBUG_LINE_SPACE].value;
+    const int pad = 16;
+    renderText(0,0,"0. Back   Play/Pause: (esc)\n\n");
+    if (state.songIndex < 0 || state.songIndex >= songs->size || gMusic == NULL) {
+        renderText(pad, lineSpace * 2, "Nothing playing");
+        return;
+    }
+    const char* song = songs->arr[state.songIndex].name;
+    SDL_Texture* art = art_get(song);
+    const SDL_Rect artQuad = {pad, lineSpace * 2, ART_THUMB_SIZE, ART_THUMB_SIZE};
+    if (art != NULL) {
+        SDL_RenderCopy(gRenderer, art, NULL, &artQuad);
+    }
+    renderText(artQuad.x + artQuad.w + pad, artQuad.y, song);
+
+    char elapsed[16];
+    char remaining[16];
+    char lineText[MAX_FILE_NAME];
+    const double position = Mix_GetMusicPosition(gMusic);
+    const double duration = Mix_MusicDuration(gMusic);
+    formatTime(elapsed, position);
+    formatTime(remaining, duration - position);
+    sprintf(lineText, "%s / -%s%s", elapsed, remaining, Mix_PausedMusic() == 1 ? "   paused" : "");
+    renderText(artQuad.x + artQuad.w + pad, artQuad.y + lineSpace, lineText);
+
+    SDL_Rect progress = {pad, artQuad.y + artQuad.h + pad, SCREEN_WIDTH - 2 * pad, 6};
+    SDL_SetRenderDrawColor(gRenderer, 60,20,0,0);
+    SDL_RenderDrawRect(gRenderer, &progress);
+    if (duration > 0) {
+        progress.w = (int) (progress.w * (position < duration ? position : duration) / duration);
+        SDL_RenderFillRect(gRenderer, &progress);
+    }
+
+    const int spectrumTop = progress.y + progress.h + pad;
+    const SDL_Rect spectrumArea = {pad, spectrumTop, SCREEN_WIDTH - 2 * pad, SCREEN_HEIGHT - 20 - spectrumTop};
+    renderSpectrum(spectrumArea);
+}
+
 void renderMain() {
     if (getMenuState() == MENU_ALL_SONGS) {
         renderSongsPage();
     } else if (getMenuState() == MENU_ARTISTS) {
         renderArtistsPage();
+    } else if (getMenuState() == MENU_NOW_PLAYING) {
+        renderNowPlayingPage();
     } else {
         renderText(0,0,menuTexts[getMenuState()]);
     }
@@ -288,6 +499,17 @@ void renderOptions() {
         sprintf(dbBuf, "%10s: %03d  [%d,%d]", debugOptions[i].description, debugOptions[i].value, debugOptions[i].min, debugOptions[i].max);
         renderTextWithColor(SCREEN_WIDTH / 2 + o, i * debugOptions[DEBUG_LINE_SPACE].value, dbBuf, state.selectedDebug == i ? selectedFontColor : fontColor);
     }
+    int line = DEBUG_PROPERTY_COUNT;
+    char costBuf[64];
+    sprintf(costBuf, "%10s: %.1fus/block", "fft", spectrum_costMicros());
+    renderText(SCREEN_WIDTH / 2 + o, line++ * debugOptions[DEBUG_LINE_SPACE].value, costBuf);
+    // current/peak, kilobytes
+    sprintf(costBuf, "%10s: %ld/%ldk", "rss", mem_rssKb(), mem_peakRssKb());
+    renderText(SCREEN_WIDTH / 2 + o, line++ * debugOptions[DEBUG_LINE_SPACE].value, costBuf);
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        sprintf(costBuf, "%10s: %ld/%ldk", mem_name(i), mem_used(i) / 1024, mem_peak(i) / 1024);
+        renderTextWithColor(SCREEN_WIDTH / 2 + o, line++ * debugOptions[DEBUG_LINE_SPACE].value, costBuf, mem_overCap(i) ? selectedFontColor : fontColor);
+    }
 }
 void renderVolumeBar() {
     const int boxes = 128/4;
@@ -307,7 +529,7 @@ void renderVolumeBar() {
         rQuad.x += w + 2 * gap;
     }
     char buf[5];
-    sprintf(buf, "%d", state.volume);
+    state.muted ? sprintf(buf, "mute") : sprintf(buf, "%d", state.volume);
     renderText(SCREEN_WIDTH - 40, SCREEN_HEIGHT - 40, buf);
 }
 //END RENDERING
@@ -343,24 +565,50 @@ bool playPauseCurrentSong() {
     return Mix_PlayingMusic() == 1 && Mix_PausedMusic() == 1;
 }
 
-bool loadAndPlaySongByIndex(const int index) {
-    Mix_VolumeMusic(state.volume);
+// user volume scaled by the current track's normalization gain
+void applyVolume() {
+    int volume = state.muted ? 0 : state.volume;
+    if (debugOptions[DEBUG_REPLAY_GAIN].value) {
+        volume = (int) ((float) volume * powf(10.0f, songGainDb / 20.0f) + 0.5f);
+    }
+    Mix_VolumeMusic(volume > MIX_MAX_VOLUME ? MIX_MAX_VOLUME : volume);
+}
+
+void updateSongGain() {
+    songGainDb = 0;
+    if (state.songIndex < 0 || state.songIndex >= songs->size) {
+        return;
+    }
+    char path[MAX_FILE_NAME * 2];
+    struct stat filestat;
+    snprintf(path, sizeof(path), "%s/%s", resourceDir, songs->arr[state.songIndex].name);
+    if (stat(path, &filestat) == -1) {
+        return;
+    }
+    const float loudness = library_loudness(songs->arr[state.songIndex].name, filestat.st_size, filestat.st_mtime);
+    if (loudness == LIBRARY_UNANALYZED) {
+        loudness_enqueue(songs->arr[state.songIndex].name);
+    }
+    songGainDb = loudness_gainDb(loudness);
+}
 
-    if (songsArr[state.pageIndex * ITEMS_PER_PAGE + index] == NULL) {
+bool loadAndPlaySongByIndex(const int index) {
+    if (state.pageIndex * ITEMS_PER_PAGE + index >= songs->size) {
         return false;
     }
-    char* fileName = songsArr[ITEMS_PER_PAGE * state.pageIndex + index];
+    char* fileName = songs->arr[ITEMS_PER_PAGE * state.pageIndex + index].name;
     pauseGSong();
     Mix_FreeMusic(gMusic);
-    char path[300] = "";
-    strcat(path, resourceDir);
-    strcat(path, "/");
-    strcat(path, fileName);
+    char path[MAX_FILE_NAME * 2];
+    snprintf(path, sizeof(path), "%s/%s", resourceDir, fileName);
     gMusic = Mix_LoadMUS(path);
     if (gMusic == NULL) {
         SDL_Log("Failed to play %s\nSDL_error: %s", path, SDL_GetError());
         return false;
     }
+    state.songIndex = ITEMS_PER_PAGE * state.pageIndex + index;
+    updateSongGain();
+    applyVolume();
     playGSong();
     return true;
 }
@@ -372,10 +620,14 @@ bool init() {
         SDL_Log("Failed to init SDL!\nSDL_Error: %s", SDL_GetError());
         return false;
     }
-    if (!IMG_Init(IMG_INIT_PNG)) {
+    const int imgFlags = IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG);
+    if ((imgFlags & IMG_INIT_PNG) == 0) {
         SDL_Log("SDL IMG could not init!\nSDL_Error: %s", SDL_GetError());
         return false;
     }
+    if ((imgFlags & IMG_INIT_JPG) == 0) {
+        SDL_Log("SDL IMG has no JPG support, JPG covers won't show\nSDL_Error: %s", SDL_GetError());
+    }
     if (TTF_Init() == -1) {
         SDL_Log("SDL TTF could not init!\nSDL_Error: %s", SDL_GetError());
         return false;
@@ -400,84 +652,340 @@ bool init() {
     return true;
 }
 
-// should probably try to understand this lol
-// https://benjaminwuethrich.dev/2015-03-07-sorting-strings-in-c-with-qsort.html
-// basically pointer to start of string (pointer)
-int cmpstr(const void* a, const void* b) {
-    return strcmp(*(char* const*) a, *(char* const*) b);
+// names from the scan, the watcher and the library index all go through here, so the length limit holds everywhere
+bool isSongFile(const char* name) {
+    const char* base = strrchr(name, '/');
+    base = base == NULL ? name : base + 1;
+    return strlen(name) < MAX_FILE_NAME && base[0] != '.' && !art_isImageFile(base);
 }
 
-void sortSongsArr() {
-    qsort(songsArr, songCount, sizeof(char*), cmpstr);
+void artistOf(const char* song, char* artistName) {
+    const char* base = strrchr(song, '/');
+    base = base == NULL ? song : base + 1;
+    const char* dash = strchr(base, '-');
+    const int len = dash == NULL ? (int) strlen(base) : (int) (dash - base);
+    snprintf(artistName, MAP_KEY_MAX, "%.*s", len, base);
 }
 
-bool detectSongs() {
-    char cwd[1024];
-    getcwd(cwd, sizeof(cwd));
+void addSongToArtists(char* song) {
+    char artistName[MAP_KEY_MAX];
+    artistOf(song, artistName);
+    Ek_List* list = map_get(artistMap, artistName);
+    if (list == NULL) {
+        list = list_new(5);
+        map_put(artistMap, artistName, list);
+    }
+    list_add(list, song);
+}
 
-    if (chdir(resourceDir) == -1) {
-        printf("Failed to chdir, errno: %d\n", errno);
-        return false;
+void removeSongFromArtists(const char* song) {
+    char artistName[MAP_KEY_MAX];
+    artistOf(song, artistName);
+    Ek_List* list = map_get(artistMap, artistName);
+    const int i = list_indexOf(list, song);
+    if (i == -1) {
+        return;
+    }
+    list_deleteIndex(list, i);
+    if (list->size == 0) {
+        map_remove(artistMap, artistName);
+        free(list->arr);
+        free(list);
     }
+}
 
-    DIR* dirp = opendir(".");
-    struct dirent* entry;
-    struct stat filestat;
+// artist -> list of that artist's song names, the list shares songs' strings
+void mapArtists() {
+    artistMap = map_new(30);
+    for (int i = 0; i < songs->size; i++) {
+        addSongToArtists(songs->arr[i].name);
+    }
+}
 
-    if (dirp == NULL) {
-        printf("Unable to read dir\n");
-        return false;
+void clearSongs() {
+    for (int i = 0; i < songs->size; i++) {
+        removeSongFromArtists(songs->arr[i].name);
+    }
+    map_destroy(artistMap);
+    catalog_destroy(songs);
+    state.songIndex = -1;
+}
+
+void addSong(const char* name) {
+    const int i = catalog_insert(songs, name);
+    if (i == -1) {
+        return;
+    }
+    addSongToArtists(songs->arr[i].name);
+    if (state.songIndex >= i) {
+        state.songIndex++;
+    }
+    loudness_enqueue(name);
+}
+
+void removeSongAt(const int i) {
+    removeSongFromArtists(songs->arr[i].name);
+    catalog_removeAt(songs, i);
+    if (state.songIndex == i) {
+        state.songIndex = -1;
+    } else if (state.songIndex > i) {
+        state.songIndex--;
+    }
+}
+
+void clampPageIndex() {
+    if (state.pageIndex > songs->size / ITEMS_PER_PAGE) {
+        state.pageIndex = songs->size / ITEMS_PER_PAGE;
+    }
+}
+
+// applied on the main thread once the watcher has seen the tree settle
+void onLibraryChange(const WatchEvent event, const char* name) {
+    // a scan in flight may already have walked past the change, it is redone instead
+    if (event == WATCH_RESCAN || scan_busy()) {
+        scan_start(resourceDir, isSongFile);
+        return;
     }
-    while ((entry = readdir(dirp))) {
-        int res = stat(entry->d_name, &filestat);
-        if (res == -1) {
-            printf("Unable to stat file: %s, errno: %d\n", entry->d_name, errno);
-            return false;
+    if (event == WATCH_ADDED && isSongFile(name)) {
+        addSong(name);
+    } else if (event == WATCH_REMOVED) {
+        bool found;
+        const int i = catalog_find(songs, name, &found);
+        if (found) {
+            removeSongAt(i);
         }
-        if (S_ISREG(filestat.st_mode) && entry->d_name[0] != '.') {
-            char* sn = malloc(sizeof(char) * 128);
-            strcpy(sn, entry->d_name);
-            songsArr[songCount++] = sn;
+    } else if (event == WATCH_REMOVED_DIR) {
+        const size_t len = strlen(name);
+        for (int i = songs->size - 1; i >= 0; i--) {
+            if (strncmp(songs->arr[i].name, name, len) == 0 && songs->arr[i].name[len] == '/') {
+                removeSongAt(i);
+            }
         }
     }
-    closedir(dirp);
-    if (chdir(cwd) == -1) {
-        printf("Failed to back to prev cwd, errno: %d\n", errno);
-        return false;
+    clampPageIndex();
+}
+
+//SNAPSHOT
+// the saved page and the menu it belongs to, until the first full scan has been swapped in
+int snapshotPage = -1;
+MenuState snapshotMenu = MENU_WELCOME;
+
+void restoreSnapshot(const Snapshot* snapshot) {
+    bool validMenus = snapshot->menuIndex >= 0 && snapshot->menuIndex < SNAPSHOT_MENU_DEPTH;
+    for (int i = 0; validMenus && i <= snapshot->menuIndex; i++) {
+        validMenus = snapshot->menus[i] >= 0 && snapshot->menus[i] < MENU_PROP_COUNT;
     }
-    return true;
+    if (validMenus) {
+        for (int i = 0; i < SNAPSHOT_MENU_DEPTH; i++) {
+            state.m_stack[i] = i <= snapshot->menuIndex ? snapshot->menus[i] : MENU_WELCOME;
+        }
+        state.m_i = snapshot->menuIndex;
+    }
+    state.pageIndex = snapshot->pageIndex > 0 ? snapshot->pageIndex : 0;
+    state.volume = snapshot->volume < 0 ? 0 : snapshot->volume > MIX_MAX_VOLUME ? MIX_MAX_VOLUME : snapshot->volume;
+    state.muted = snapshot->muted;
 }
 
-void mapArtists() {
-    artistMap = map_new(30);
-    char* artistName = strtok(songsArr[0], "-");
-    Ek_List* list = list_new(6);
-    for (int i = 1; i < songCount; i++) {
-        char* next = strtok(songsArr[i], "-");
-        if (strcmp(artistName, next) == 0) {
-            list_add(list, strtok(NULL, "\n"));
-        } else {
-            map_put(artistMap, artistName, list);
-            artistName = next;
-            list = list_new(5);
+// the first frame's catalog is just the songs that were on screen, stale ones are
+// left out. returns their page, -1 when none of them exist anymore
+int restoreVisibleSongs(const Snapshot* snapshot) {
+    int page = -1;
+    for (int i = 0; i < snapshot->visibleCount; i++) {
+        char path[MAX_FILE_NAME * 2];
+        struct stat filestat;
+        if (!isSongFile(snapshot->visible[i])) {
+            continue;
         }
+        snprintf(path, sizeof(path), "%s/%s", resourceDir, snapshot->visible[i]);
+        if (stat(path, &filestat) == -1) {
+            continue;
+        }
+        catalog_insert(songs, snapshot->visible[i]);
+    }
+    for (int i = 0; i < snapshot->visibleCount && page == -1; i++) {
+        bool found;
+        const int index = catalog_find(songs, snapshot->visible[i], &found);
+        page = found ? index / ITEMS_PER_PAGE : -1;
+    }
+    return page;
+}
+
+// picks the snapshot's track back up where it was, paused if it was paused
+void resumePlayback(const Snapshot* snapshot) {
+    if (snapshot->song[0] == '\0' || !isSongFile(snapshot->song)) {
+        return;
+    }
+    char path[SNAPSHOT_NAME_MAX * 2];
+    snprintf(path, sizeof(path), "%s/%s", resourceDir, snapshot->song);
+    gMusic = Mix_LoadMUS(path);
+    if (gMusic == NULL) {
+        SDL_Log("Failed to resume %s\nSDL_Error: %s", path, SDL_GetError());
+        return;
+    }
+    bool found;
+    const int i = catalog_find(songs, snapshot->song, &found);
+    state.songIndex = found ? i : catalog_insert(songs, snapshot->song);
+    updateSongGain();
+    applyVolume();
+    Mix_PlayMusic(gMusic, 0);
+    if (snapshot->position > 0 && Mix_SetMusicPosition(snapshot->position) != 0) {
+        SDL_Log("Failed to seek %s\nSDL_Error: %s", path, SDL_GetError());
+    }
+    if (!snapshot->playing) {
+        Mix_PauseMusic();
+    }
+}
+
+void saveSnapshot() {
+    Snapshot snapshot;
+    memset(&snapshot, 0, sizeof(Snapshot));
+    for (int i = 0; i < SNAPSHOT_MENU_DEPTH; i++) {
+        snapshot.menus[i] = state.m_stack[i];
+    }
+    snapshot.menuIndex = state.m_i;
+    // until the first scan lands the catalog is only the restored page, its index would be wrong
+    snapshot.pageIndex = snapshotPage >= 0 && getMenuState() == snapshotMenu ? snapshotPage : state.pageIndex;
+    snapshot.volume = state.volume;
+    snapshot.muted = state.muted;
+    if (gMusic != NULL && state.songIndex >= 0 && state.songIndex < songs->size) {
+        const double position = Mix_PlayingMusic() == 1 ? Mix_GetMusicPosition(gMusic) : 0;
+        snprintf(snapshot.song, sizeof(snapshot.song), "%s", songs->arr[state.songIndex].name);
+        snapshot.position = position > 0 ? position : 0;
+        snapshot.playing = Mix_PlayingMusic() == 1 && Mix_PausedMusic() != 1;
+    }
+    const int font = debugOptions[DEBUG_FONT].value;
+    if (font >= 0 && font < fontCount) {
+        snprintf(snapshot.font, sizeof(snapshot.font), "%s", fontFiles[font]);
+        snapshot.fontSize = debugOptions[DEBUG_FONT_SIZE].value;
+        memcpy(snapshot.glyphs, glyphRects, sizeof(snapshot.glyphs));
+        saveGlyphAtlas();
+    }
+    // other menus page through something else, their page index is all that's kept
+    if (getMenuState() == MENU_ALL_SONGS) {
+        for (int i = state.pageIndex * ITEMS_PER_PAGE; i < songs->size && snapshot.visibleCount < SNAPSHOT_VISIBLE; i++) {
+            snprintf(snapshot.visible[snapshot.visibleCount++], SNAPSHOT_NAME_MAX, "%s", songs->arr[i].name);
+        }
+    }
+    snapshot_write(snapshotPath, &snapshot);
+}
+//END SNAPSHOT
+//BOOT TIMING
+typedef struct {
+    const char* name;
+    double ms;
+} BootPhase;
+
+BootPhase bootPhases[16];
+int bootPhaseCount = 0;
+Uint64 bootMark = 0;
+
+// the time since the previous mark is booked to name, NULL just starts the clock
+void markBootPhase(const char* name) {
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if (name != NULL && bootPhaseCount < 16) {
+        bootPhases[bootPhaseCount].name = name;
+        bootPhases[bootPhaseCount].ms = (double) (now - bootMark) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+        bootPhaseCount++;
+    }
+    bootMark = now;
+}
+
+double bootPhasesMs() {
+    double total = 0;
+    for (int i = 0; i < bootPhaseCount; i++) {
+        total += bootPhases[i].ms;
     }
+    return total;
 }
 
+void logBootPhases() {
+    for (int i = 0; i < bootPhaseCount; i++) {
+        SDL_Log("boot: %-12s %8.1f ms", bootPhases[i].name, bootPhases[i].ms);
+    }
+    SDL_Log("boot: %-12s %8.1f ms", "total", bootPhasesMs());
+}
+//END BOOT TIMING
+
+// only what the first frame needs, the rest waits for loadDeferred
 bool loadMedia() {
+    Snapshot snapshot;
     populateDebugOptions();
     readConfigFile();
+    mem_setBudget(debugOptions[DEBUG_MEM_BUDGET].value);
+    library_load(libraryPath);
     scanFontDir();
-    loadFont();
-    loadFontTextureMap();
-    detectSongs();
-    sortSongsArr();
+    const bool restored = snapshot_read(snapshotPath, &snapshot);
+    markBootPhase("config");
+    if (!(restored && loadSnapshotGlyphAtlas(&snapshot))) {
+        reloadFont();
+    }
+    markBootPhase("glyphs");
+    catalog_setStripArticles(NULL, debugOptions[DEBUG_SORT_ARTICLES].value);
+    songs = catalog_new(SNAPSHOT_VISIBLE + 1);
+    if (restored) {
+        restoreSnapshot(&snapshot);
+        snapshotPage = state.pageIndex;
+        snapshotMenu = getMenuState();
+        const int visiblePage = getMenuState() == MENU_ALL_SONGS ? restoreVisibleSongs(&snapshot) : -1;
+        state.pageIndex = visiblePage >= 0 ? visiblePage : state.pageIndex;
+        resumePlayback(&snapshot);
+    }
+    // not clamped, an artist page can be past what the first frame's few songs make up
     mapArtists();
+    markBootPhase("resume");
     return true;
 }
+
+// swaps in a finished scan, the playing song keeps its place by name
+void onSongsScanned(Catalog* catalog) {
+    char* playing = state.songIndex >= 0 ? strdup(songs->arr[state.songIndex].name) : NULL;
+    clearSongs();
+    songs = catalog;
+    if (playing != NULL) {
+        bool found;
+        const int i = catalog_find(songs, playing, &found);
+        state.songIndex = found ? i : -1;
+        free(playing);
+    }
+    mapArtists();
+    // the first frame only had the saved page's songs, the saved page index is only meaningful against the full catalog
+    if (snapshotPage >= 0 && getMenuState() == snapshotMenu) {
+        state.pageIndex = snapshotPage;
+    }
+    snapshotPage = -1;
+    clampPageIndex();
+}
+
+// everything off screen, run once the first frame is presented
+void loadDeferred() {
+    art_init(resourceDir, artCacheDir);
+    spectrum_init();
+    markBootPhase("art/fft");
+    loudness_init(resourceDir);
+    if (state.songIndex >= 0) {
+        loudness_enqueue(songs->arr[state.songIndex].name);
+    }
+    markBootPhase("loudness");
+    // the full catalog comes back through scan_poll, the rest of the songs are queued for loudness from there
+    scan_start(resourceDir, isSongFile);
+    watch_init(resourceDir);
+    markBootPhase("watch");
+}
 //END INIT / LOAD MEDIA
 // CLEANUP
 void cleanup() {
+    scan_quit();
+    watch_quit();
+    spectrum_quit();
+    loudness_quit();
+    art_quit();
+    library_save();
+    library_quit();
+    clearFontTextureMap();
+    TTF_CloseFont(dFont);
+    for (int i = 0; i < fontCount; i++) {
+        free(fontFiles[i]);
+    }
     SDL_DestroyRenderer(gRenderer);
     SDL_DestroyWindow(gWindow);
     Mix_Quit();
@@ -510,8 +1018,24 @@ void adjustSelectedDebugValue(const int delta) {
         db->value = res;
     }
     if (state.selectedDebug == DEBUG_FONT || state.selectedDebug == DEBUG_FONT_SIZE) {
-        loadFont();
-        loadFontTextureMap();
+        reloadFont();
+    }
+    if (state.selectedDebug == DEBUG_MEM_BUDGET) {
+        mem_setBudget(db->value);
+    }
+    if (state.selectedDebug == DEBUG_REPLAY_GAIN) {
+        applyVolume();
+    }
+    if (state.selectedDebug == DEBUG_SORT_ARTICLES) {
+        // re-key and re-sort, the playing song keeps its place by name
+        const char* playing = state.songIndex >= 0 ? songs->arr[state.songIndex].name : NULL;
+        catalog_setStripArticles(songs, db->value);
+        for (int i = 0; playing != NULL && i < songs->size; i++) {
+            if (songs->arr[i].name == playing) {
+                state.songIndex = i;
+                break;
+            }
+        }
     }
 }
 
@@ -524,35 +1048,102 @@ void adjustVolume(const int delta) {
     } else {
         state.volume = res;
     }
-    Mix_VolumeMusic(state.volume);
+    applyVolume();
 }
 
-void handleSettingsKeypress(SDL_Keysym ks) {
-    const int sym = ks.sym;
-    bool shifted = ks.mod == KMOD_LSHIFT ? true : false;
-    int keyNum = keysymToInt(ks);
+// coalesced over a frame and applied once by applyPendingInput
+typedef struct {
+    int pageDelta;
+    int volumeDelta;
+    int debugMove;
+    int debugDelta;
+} PendingInput;
+
+PendingInput pendingInput = {0, 0, 0, 0};
 
-    if (sym == SDLK_UP || keyNum == 8) {
-        if ((int) state.selectedDebug - 1 >= 0) {
-            state.selectedDebug--;
-        }
-    } else if (sym == SDLK_DOWN || keyNum == 5) {
-        if (state.selectedDebug + 1 < DEBUG_PROPERTY_COUNT) {
-            state.selectedDebug++;
+int maxPageIndex() {
+    if (getMenuState() == MENU_ARTISTS) {
+        return artistMap->size / ITEMS_PER_PAGE;
+    }
+    return songs->size / ITEMS_PER_PAGE;
+}
+
+void applyPendingInput() {
+    if (pendingInput.pageDelta != 0) {
+        const int page = state.pageIndex + pendingInput.pageDelta;
+        const int maxPage = maxPageIndex();
+        state.pageIndex = page < 0 ? 0 : page > maxPage ? maxPage : page;
+    }
+    if (pendingInput.volumeDelta != 0) {
+        adjustVolume(pendingInput.volumeDelta);
+    }
+    if (pendingInput.debugMove != 0) {
+        const int selected = (int) state.selectedDebug + pendingInput.debugMove;
+        state.selectedDebug = selected < 0 ? 0 : selected >= DEBUG_PROPERTY_COUNT ? DEBUG_PROPERTY_COUNT - 1 : selected;
+    }
+    if (pendingInput.debugDelta != 0) {
+        adjustSelectedDebugValue(pendingInput.debugDelta);
+    }
+    pendingInput = (PendingInput) {0, 0, 0, 0};
+}
+
+bool isRepeatable(const SDL_Keysym ks) {
+    const SDL_Keycode k = ks.sym;
+    const int keyNum = keysymToInt(ks);
+    if (state.optionsOpen) {
+        return k == SDLK_UP || k == SDLK_DOWN || k == SDLK_LEFT || k == SDLK_RIGHT ||
+               keyNum == 8 || keyNum == 5 || keyNum == 4 || keyNum == 6;
+    }
+    return k == SDLK_KP_MULTIPLY || k == SDLK_KP_DIVIDE || k == SDLK_KP_PLUS || k == SDLK_KP_MINUS;
+}
+
+void handleSettingsKeypress(const InputPress* press) {
+    const int sym = press->ks.sym;
+    bool shifted = press->ks.mod == KMOD_LSHIFT ? true : false;
+    int keyNum = keysymToInt(press->ks);
+
+    if (sym == SDLK_UP || keyNum == 8 || sym == SDLK_DOWN || keyNum == 5) {
+        // a value change queued this frame belongs to the option selected before the move
+        if (pendingInput.debugDelta != 0) {
+            applyPendingInput();
         }
+        pendingInput.debugMove += (sym == SDLK_UP || keyNum == 8 ? -1 : 1) * press->steps;
     } else if (sym == SDLK_LEFT || keyNum == 4) {
-        shifted ? adjustSelectedDebugValue(-5) : adjustSelectedDebugValue(-1);
+        pendingInput.debugDelta -= (shifted ? 5 : 1) * press->steps;
     } else if (sym == SDLK_RIGHT || keyNum == 6) {
-        shifted ? adjustSelectedDebugValue(5) : adjustSelectedDebugValue(1);
+        pendingInput.debugDelta += (shifted ? 5 : 1) * press->steps;
+    }
+}
+
+// INPUT_CHORD_KEY + key
+void handleChord(const SDL_Keysym ks) {
+    const SDL_Keycode k = ks.sym;
+    const int keyNum = keysymToInt(ks);
+    if (k == SDLK_KP_MULTIPLY) {
+        state.pageIndex = maxPageIndex();
+    } else if (k == SDLK_KP_DIVIDE) {
+        state.pageIndex = 0;
+    } else if (k == SDLK_KP_MINUS || k == SDLK_KP_PLUS) {
+        state.muted = !state.muted;
+        applyVolume();
+    } else if (keyNum == 0) {
+        pushMenuState(MENU_NOW_PLAYING);
+    } else if (keyNum > 0) {
+        state.pageIndex = maxPageIndex() * keyNum / 10; // 1-9 jump to 10%-90% of the list
     }
 }
 
-void handleKeypress(const SDL_Keysym ks) {
+void handleKeypress(const InputPress* press) {
+    const SDL_Keysym ks = press->ks;
     const SDL_Keycode k = ks.sym;
     const int keyIndex = keysymToInt(ks);
     const MenuState menu_state = getMenuState();
 
+    if (press->repeat && (press->chord || !isRepeatable(ks))) {
+        return;
+    }
     if (k == SDLK_PERIOD || k == SDLK_KP_PERIOD) {
+        applyPendingInput();
         if (state.optionsOpen) {
             state.optionsOpen = false;
             writeToConfig();
@@ -562,15 +1153,32 @@ void handleKeypress(const SDL_Keysym ks) {
         return;
     }
     if (state.optionsOpen) {
-        handleSettingsKeypress(ks);
+        handleSettingsKeypress(press);
+        return;
+    }
+    if (press->chord) {
+        applyPendingInput();
+        handleChord(ks);
+        return;
+    }
+    if (k == SDLK_KP_MULTIPLY || k == SDLK_KP_DIVIDE) {
+        pendingInput.pageDelta += (k == SDLK_KP_MULTIPLY ? 1 : -1) * press->steps;
+        return;
+    }
+    if (k == SDLK_KP_PLUS || k == SDLK_KP_MINUS) {
+        // volume only ever doubles up, the full range still takes a second
+        const int steps = press->steps < 2 ? press->steps : 2;
+        pendingInput.volumeDelta += (k == SDLK_KP_PLUS ? VOLUME_STEP : -VOLUME_STEP) * steps;
         return;
     }
+    // everything below reads the page / menu the queued presses lead to
+    applyPendingInput();
 
     if (keyIndex > 0) { // pos number pressed
         if (menu_state == MENU_WELCOME) {
             pushMenuState(MENU_NAVIGATE);
         } else if (menu_state == MENU_NAVIGATE) {
-            if (keyIndex < MENU_PROP_COUNT) {
+            if (keyIndex + 1 < MENU_PROP_COUNT) {
                 pushMenuState(keyIndex + 1);
             }
         } else if (menu_state == MENU_ALL_SONGS) {
@@ -586,20 +1194,89 @@ void handleKeypress(const SDL_Keysym ks) {
     if (k == SDLK_BACKSPACE) {
         pushMenuState(MENU_WELCOME);
     }
-    if (k == SDLK_KP_MULTIPLY && songCount / ITEMS_PER_PAGE > state.pageIndex) {
-        state.pageIndex++;
+}
+
+// a burst of keys within a frame ends up as a single state transition
+void handleInput() {
+    InputPress presses[INPUT_MAX_PRESSES];
+    const int n = input_poll(presses, SDL_GetTicks64(), debugOptions[DEBUG_REPEAT_DELAY].value, debugOptions[DEBUG_REPEAT_MAX].value);
+    for (int i = 0; i < n; i++) {
+        handleKeypress(&presses[i]);
+    }
+    applyPendingInput();
+}
+//END MENU NAVIGATION
+
+//SOAK
+// --soak [minutes] drives the ui through fonts, pages and tracks and fails
+// when RSS keeps growing once the caches have warmed up
+const int SOAK_WARMUP_MS = 120000;
+const long SOAK_GROWTH_KB = 4096;
+
+typedef struct {
+    bool enabled;
+    bool failed;
+    Uint64 end;
+    Uint64 nextSample;
+    long baselineKb;
+    int frame;
+} Soak;
+
+Soak soak = {false, false, 0, 0, 0, 0};
+
+void startSoak(const int minutes) {
+    const Uint64 now = SDL_GetTicks64();
+    soak.enabled = true;
+    soak.end = now + (Uint64) minutes * 60000;
+    soak.nextSample = now + SOAK_WARMUP_MS;
+    state.muted = true;
+    applyVolume();
+    SDL_Log("soak: %d min, rss %ld KB", minutes, mem_rssKb());
+}
+
+void logSoakSample(const long rssKb) {
+    SDL_Log("soak: rss %ld KB (baseline %ld KB, peak %ld KB)", rssKb, soak.baselineKb, mem_peakRssKb());
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        SDL_Log("soak: %10s %ld KB, peak %ld KB", mem_name(i), mem_used(i) / 1024, mem_peak(i) / 1024);
+    }
+}
+
+// one step per frame, false once the run is over
+bool soakStep() {
+    static const MenuState menus[] = {MENU_ALL_SONGS, MENU_ARTISTS, MENU_NOW_PLAYING};
+    const Uint64 now = SDL_GetTicks64();
+    soak.frame++;
+    state.pageIndex = maxPageIndex() > 0 ? (state.pageIndex + 1) % (maxPageIndex() + 1) : 0;
+    if (soak.frame % FRAME_RATE == 0) {
+        state.m_i = 1;
+        state.m_stack[1] = menus[soak.frame / FRAME_RATE % 3];
     }
-    if (k == SDLK_KP_DIVIDE && state.pageIndex > 0) {
-        state.pageIndex--;
+    if (soak.frame % (FRAME_RATE * 2) == 0 && fontCount > 0) {
+        debugOptions[DEBUG_FONT].value = (debugOptions[DEBUG_FONT].value + 1) % fontCount;
+        debugOptions[DEBUG_FONT_SIZE].value = 12 + soak.frame % 40;
+        reloadFont();
     }
-    if (k == SDLK_KP_MINUS) {
-        adjustVolume(-4);
+    if (soak.frame % (FRAME_RATE * 5) == 0) {
+        loadAndPlaySongByIndex(rand() % ITEMS_PER_PAGE);
+    }
+    if (now >= soak.nextSample) {
+        const long rssKb = mem_rssKb();
+        if (soak.baselineKb == 0) {
+            soak.baselineKb = rssKb;
+        }
+        logSoakSample(rssKb);
+        soak.nextSample = now + 60000;
     }
-    if (k == SDLK_KP_PLUS) {
-        adjustVolume(4);
+    if (now < soak.end) {
+        return true;
     }
+    const long rssKb = mem_rssKb();
+    soak.failed = soak.baselineKb != 0 && rssKb - soak.baselineKb > SOAK_GROWTH_KB;
+    logSoakSample(rssKb);
+    SDL_Log("soak: %s, rss grew %ld KB after warmup", soak.failed ? "FAILED" : "ok", rssKb - soak.baselineKb);
+    return false;
 }
-//END MENU NAVIGATION
+//END SOAK
 
 //MAIN LOOP
 int main(int argc, char *argv[]) {
@@ -608,22 +1285,61 @@ int main(int argc, char *argv[]) {
     SDL_Event e;
     int32_t countedFrames = 0;
 
-    if (!(init() && loadMedia())) {
+    if (argc > 1 && strcmp(argv[1], "--bench-fft") == 0) {
+        printf("fft %d: %.2f us/block\n", SPECTRUM_FFT_SIZE, spectrum_benchFft(20000));
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-sort") == 0) {
+        catalog_benchSort(argc > 2 ? (int) strtol(argv[2], NULL, 10) : 100000);
         return 0;
     }
+    if (argc > 1 && strcmp(argv[1], "--bench-loudness") == 0) {
+        printf("loudness: %.0f s audio / s cpu\n", loudness_bench(600));
+        return 0;
+    }
+    markBootPhase(NULL);
+    if (!init()) {
+        return 0;
+    }
+    markBootPhase("sdl init");
+    if (!loadMedia()) {
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--soak") == 0) {
+        startSoak(argc > 2 ? (int) strtol(argv[2], NULL, 10) : 240);
+    }
 
+    int gainGeneration = loudness_generation();
+    bool booted = false;
     while (!quit) {
         startTimer(&syncTimer);
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE) {
                 quit = true;
             }
+            if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                input_reset();
+            }
             if (e.type == SDL_KEYDOWN) {
-                handleKeypress(e.key.keysym);
+                input_keyDown(&e.key);
             }
-
+            if (e.type == SDL_KEYUP) {
+                input_keyUp(&e.key);
+            }
+        }
+        handleInput();
+        if (soak.enabled && !soakStep()) {
+            quit = true;
         }
 
+        scan_poll(onSongsScanned);
+        watch_poll(onLibraryChange);
+        art_pump(gRenderer);
+        if (gainGeneration != loudness_generation()) {
+            gainGeneration = loudness_generation();
+            updateSongGain();
+            applyVolume();
+        }
         SDL_SetRenderDrawColor(gRenderer, debugOptions[0].value, debugOptions[1].value, debugOptions[2].value, 255);
         SDL_RenderClear(gRenderer);
         renderMain();
@@ -632,6 +1348,14 @@ int main(int argc, char *argv[]) {
             renderOptions();
         }
         SDL_RenderPresent(gRenderer);
+        if (!booted) {
+            markBootPhase("first frame");
+            const double visibleMs = bootPhasesMs();
+            SDL_Log("boot: first frame after %.1f ms%s", visibleMs, visibleMs > BOOT_BUDGET_MS ? ", over budget" : "");
+            loadDeferred();
+            logBootPhases();
+            booted = true;
+        }
 
         //wait
         Uint64 frameTicks = SDL_GetTicks64() - syncTimer.startTicks;
@@ -640,6 +1364,9 @@ int main(int argc, char *argv[]) {
         }
         countedFrames++;
     }
+    if (!soak.enabled) {
+        saveSnapshot();
+    }
     cleanup();
-    return 0;
+    return soak.failed ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+//
+// Memory accounting, see mem.h
+//
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "mem.h"
+
+// percent of the budget each subsystem gets, decoding a whole track for
+// loudness analysis is by far the biggest single allocation
+static const int shares[MEM_SUBSYSTEM_COUNT] = {10, 5, 25, 60};
+static const char* names[MEM_SUBSYSTEM_COUNT] = {"catalog", "glyphs", "textures", "audio"};
+
+// audio is accounted from the loudness worker, the rest from the main thread
+static SDL_atomic_t used[MEM_SUBSYSTEM_COUNT];
+static SDL_atomic_t peak[MEM_SUBSYSTEM_COUNT];
+static long caps[MEM_SUBSYSTEM_COUNT];
+
+void mem_add(const MemSubsystem sys, const long bytes) {
+    const int now = SDL_AtomicAdd(&used[sys], (int) bytes) + (int) bytes;
+    int old = SDL_AtomicGet(&peak[sys]);
+    while (now > old && !SDL_AtomicCAS(&peak[sys], old, now)) {
+        old = SDL_AtomicGet(&peak[sys]);
+    }
+}
+
+long mem_used(const MemSubsystem sys) {
+    return SDL_AtomicGet(&used[sys]);
+}
+
+long mem_peak(const MemSubsystem sys) {
+    return SDL_AtomicGet(&peak[sys]);
+}
+
+long mem_cap(const MemSubsystem sys) {
+    return caps[sys];
+}
+
+bool mem_overCap(const MemSubsystem sys) {
+    return caps[sys] != 0 && mem_used(sys) > caps[sys];
+}
+
+void mem_setBudget(const int megabytes) {
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        caps[i] = (long) megabytes * 1024 * 1024 / 100 * shares[i];
+    }
+}
+
+const char* mem_name(const MemSubsystem sys) {
+    return names[sys];
+}
+
+long mem_rssKb() {
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/statm", "r");
+    long pages = 0;
+    if (f != NULL) {
+        if (fscanf(f, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(f);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return mem_peakRssKb(); // no cheap current RSS, the high water mark still shows growth
+#endif
+}
+
+long mem_peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
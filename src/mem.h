@@ -0,0 +1,31 @@
+//
+// Memory accounting for small boards. Subsystems report what they allocate
+// and release, caches check their share of the budget and evict to stay under
+// it. A budget of 0 turns the caps off, usage and peaks are tracked either way.
+//
+
+#ifndef MEM_H
+#define MEM_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+typedef enum {
+    MEM_CATALOG,
+    MEM_GLYPHS,
+    MEM_TEXTURES,
+    MEM_AUDIO,
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+void mem_add(MemSubsystem sys, long bytes); // negative to release
+long mem_used(MemSubsystem sys);
+long mem_peak(MemSubsystem sys);
+long mem_cap(MemSubsystem sys);
+bool mem_overCap(MemSubsystem sys);
+void mem_setBudget(int megabytes);
+const char* mem_name(MemSubsystem sys);
+
+long mem_rssKb();
+long mem_peakRssKb();
+#endif //MEM_H
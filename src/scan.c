@@ -0,0 +1,125 @@
+//
+// Background music dir scan, see scan.h
+//
+#include <errno.h>
+#include <stdio.h>
+#include <SDL.h>
+#include "dirent.h"
+#include "sys/stat.h"
+#include "scan.h"
+#include "loudness.h"
+
+static char rootDir[SCAN_PATH_MAX];
+static ScanFilter filter = NULL;
+static SDL_Thread* worker = NULL;
+static SDL_atomic_t done;
+static SDL_atomic_t cancelled;
+static bool again = false;
+static Catalog* result = NULL;
+
+// walks rootDir recursively, song names are relative to it ("sub/Artist-Title.mp3")
+static void scanDir(Catalog* catalog, const char* rel) {
+    char path[SCAN_PATH_MAX * 2];
+    snprintf(path, sizeof(path), rel[0] == '\0' ? "%s%s" : "%s/%s", rootDir, rel);
+    DIR* dirp = opendir(path);
+    struct dirent* entry;
+    struct stat filestat;
+
+    if (dirp == NULL) {
+        printf("Unable to read dir %s\n", path);
+        return;
+    }
+    while ((entry = readdir(dirp)) && !SDL_AtomicGet(&cancelled)) {
+        char name[SCAN_PATH_MAX];
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        const int len = snprintf(name, sizeof(name), rel[0] == '\0' ? "%s%s" : "%s/%s", rel, entry->d_name);
+        if (len >= sizeof(name)) {
+            printf("Skipping %s/%s, path too long\n", rel, entry->d_name);
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", rootDir, name);
+        if (stat(path, &filestat) == -1) {
+            printf("Unable to stat file: %s, errno: %d\n", path, errno);
+            continue;
+        }
+        if (S_ISDIR(filestat.st_mode)) {
+            scanDir(catalog, name);
+        } else if (S_ISREG(filestat.st_mode) && filter(name)) {
+            catalog_append(catalog, name);
+        }
+    }
+    closedir(dirp);
+}
+
+static int scanWorker(void* data) {
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    const Uint64 start = SDL_GetPerformanceCounter();
+    Catalog* catalog = catalog_new(128);
+    scanDir(catalog, "");
+    if (!SDL_AtomicGet(&cancelled)) {
+        catalog_sort(catalog);
+        // first song is analyzed first, the queue is worked newest to oldest
+        for (int i = catalog->size - 1; i >= 0; i--) {
+            loudness_enqueue(catalog->arr[i].name);
+        }
+        SDL_Log("scan: %d songs in %.1f ms", catalog->size,
+                (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / (double) SDL_GetPerformanceFrequency());
+    }
+    result = catalog;
+    SDL_AtomicSet(&done, 1);
+    return 0;
+}
+
+static void startWorker() {
+    SDL_AtomicSet(&done, 0);
+    SDL_AtomicSet(&cancelled, 0);
+    worker = SDL_CreateThread(scanWorker, "scan", NULL);
+    if (worker == NULL) {
+        SDL_Log("Failed to start scan worker, scanning in place!\nSDL_Error: %s", SDL_GetError());
+        scanWorker(NULL);
+    }
+}
+
+// a scan already running is redone once it finishes, it may have walked past the change
+void scan_start(const char* dir, const ScanFilter isSong) {
+    if (scan_busy()) {
+        again = true;
+        return;
+    }
+    snprintf(rootDir, sizeof(rootDir), "%s", dir);
+    filter = isSong;
+    startWorker();
+}
+
+bool scan_busy() {
+    return worker != NULL || result != NULL;
+}
+
+void scan_poll(const ScanCallback callback) {
+    if (!SDL_AtomicGet(&done)) {
+        return;
+    }
+    SDL_WaitThread(worker, NULL);
+    worker = NULL;
+    SDL_AtomicSet(&done, 0);
+    Catalog* catalog = result;
+    result = NULL;
+    callback(catalog);
+    if (again) {
+        again = false;
+        startWorker();
+    }
+}
+
+void scan_quit() {
+    SDL_AtomicSet(&cancelled, 1);
+    SDL_WaitThread(worker, NULL);
+    worker = NULL;
+    if (result != NULL) {
+        catalog_destroy(result);
+        result = NULL;
+    }
+    again = false;
+}
@@ -0,0 +1,24 @@
+//
+// Full music dir scan on a worker thread. The finished, sorted catalog is
+// handed back through scan_poll on the main thread, which swaps it in; every
+// track it found is queued for loudness analysis from the worker.
+//
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "stdbool.h"
+#include "catalog.h"
+
+#define SCAN_PATH_MAX 512
+
+// name is relative to the scanned dir
+typedef bool (*ScanFilter)(const char* name);
+// takes ownership of the catalog
+typedef void (*ScanCallback)(Catalog* catalog);
+
+void scan_start(const char* dir, ScanFilter filter);
+bool scan_busy();
+void scan_poll(ScanCallback callback);
+void scan_quit();
+#endif //SCAN_H
@@ -0,0 +1,98 @@
+//
+// Fast boot snapshot, see snapshot.h
+// one "key=value" per line like the config, one "glyph=c x y w h" line per glyph
+//
+#include <stdio.h>
+#include <string.h>
+#include "snapshot.h"
+
+#include <stdlib.h>
+
+#define SNAPSHOT_LINE_MAX (SNAPSHOT_NAME_MAX + 16)
+
+static void readName(char* out, const char* value) {
+    snprintf(out, SNAPSHOT_NAME_MAX, "%s", value);
+    out[strcspn(out, "\n")] = '\0';
+}
+
+// false when there is no snapshot or it was written by another version
+bool snapshot_read(const char* path, Snapshot* snapshot) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+    memset(snapshot, 0, sizeof(Snapshot));
+    char line[SNAPSHOT_LINE_MAX];
+    int version = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char* value = strchr(line, '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        if (strcmp(line, "snapshot") == 0) {
+            version = (int) strtol(value, NULL, 10);
+        } else if (strcmp(line, "menus") == 0) {
+            sscanf(value, "%d %d %d %d %d", &snapshot->menuIndex,
+                   &snapshot->menus[0], &snapshot->menus[1], &snapshot->menus[2], &snapshot->menus[3]);
+        } else if (strcmp(line, "page") == 0) {
+            snapshot->pageIndex = (int) strtol(value, NULL, 10);
+        } else if (strcmp(line, "volume") == 0) {
+            snapshot->volume = (int) strtol(value, NULL, 10);
+        } else if (strcmp(line, "muted") == 0) {
+            snapshot->muted = strtol(value, NULL, 10) != 0;
+        } else if (strcmp(line, "song") == 0) {
+            readName(snapshot->song, value);
+        } else if (strcmp(line, "position") == 0) {
+            snapshot->position = strtod(value, NULL);
+        } else if (strcmp(line, "playing") == 0) {
+            snapshot->playing = strtol(value, NULL, 10) != 0;
+        } else if (strcmp(line, "font") == 0) {
+            readName(snapshot->font, value);
+        } else if (strcmp(line, "fontsize") == 0) {
+            snapshot->fontSize = (int) strtol(value, NULL, 10);
+        } else if (strcmp(line, "visible") == 0 && snapshot->visibleCount < SNAPSHOT_VISIBLE) {
+            readName(snapshot->visible[snapshot->visibleCount++], value);
+        } else if (strcmp(line, "glyph") == 0) {
+            int c;
+            SDL_Rect r;
+            if (sscanf(value, "%d %d %d %d %d", &c, &r.x, &r.y, &r.w, &r.h) == 5 && c >= 0 && c < SNAPSHOT_GLYPHS) {
+                snapshot->glyphs[c] = r;
+            }
+        }
+    }
+    fclose(f);
+    return version == SNAPSHOT_VERSION;
+}
+
+bool snapshot_write(const char* path, const Snapshot* snapshot) {
+    char tmpPath[SNAPSHOT_LINE_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE* f = fopen(tmpPath, "w");
+    if (f == NULL) {
+        printf("Failed to open snapshot for write\n");
+        return false;
+    }
+    fprintf(f, "snapshot=%d\n", SNAPSHOT_VERSION);
+    fprintf(f, "menus=%d %d %d %d %d\n", snapshot->menuIndex,
+            snapshot->menus[0], snapshot->menus[1], snapshot->menus[2], snapshot->menus[3]);
+    fprintf(f, "page=%d\n", snapshot->pageIndex);
+    fprintf(f, "volume=%d\n", snapshot->volume);
+    fprintf(f, "muted=%d\n", snapshot->muted);
+    fprintf(f, "song=%s\n", snapshot->song);
+    fprintf(f, "position=%.3f\n", snapshot->position);
+    fprintf(f, "playing=%d\n", snapshot->playing);
+    fprintf(f, "font=%s\n", snapshot->font);
+    fprintf(f, "fontsize=%d\n", snapshot->fontSize);
+    for (int i = 0; i < snapshot->visibleCount; i++) {
+        fprintf(f, "visible=%s\n", snapshot->visible[i]);
+    }
+    for (int c = 0; c < SNAPSHOT_GLYPHS; c++) {
+        const SDL_Rect r = snapshot->glyphs[c];
+        if (r.w > 0) {
+            fprintf(f, "glyph=%d %d %d %d %d\n", c, r.x, r.y, r.w, r.h);
+        }
+    }
+    fclose(f);
+    return rename(tmpPath, path) == 0;
+}
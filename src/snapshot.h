@@ -0,0 +1,38 @@
+//
+// Fast boot snapshot: UI and playback state written on shutdown and read back
+// at boot, so the last screen and track come back before anything slow runs.
+// The glyph atlas of the font in use is stored next to it as a PNG, its glyph
+// rects live in the snapshot.
+//
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_NAME_MAX 512
+#define SNAPSHOT_MENU_DEPTH 4
+#define SNAPSHOT_GLYPHS 256
+#define SNAPSHOT_VISIBLE 9
+
+typedef struct {
+    int menus[SNAPSHOT_MENU_DEPTH];
+    int menuIndex;
+    int pageIndex;
+    int volume;
+    bool muted;
+    char song[SNAPSHOT_NAME_MAX]; // "" when nothing was loaded
+    double position;
+    bool playing;
+    char font[SNAPSHOT_NAME_MAX];
+    int fontSize;
+    SDL_Rect glyphs[SNAPSHOT_GLYPHS]; // atlas src rects, w == 0 for no glyph
+    char visible[SNAPSHOT_VISIBLE][SNAPSHOT_NAME_MAX]; // songs on the page that was showing
+    int visibleCount;
+} Snapshot;
+
+bool snapshot_read(const char* path, Snapshot* snapshot);
+bool snapshot_write(const char* path, const Snapshot* snapshot);
+#endif //SNAPSHOT_H
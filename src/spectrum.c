@@ -0,0 +1,258 @@
+//
+// Spectrum visualizer, see spectrum.h
+//
+#include <math.h>
+#include <SDL_mixer.h>
+#include "spectrum.h"
+
+#include <stdlib.h>
+
+#define SPECTRUM_RING (SPECTRUM_FFT_SIZE * 4)
+#define SPECTRUM_LOW_HZ 40.0f
+#define SPECTRUM_HIGH_HZ 16000.0f
+#define SPECTRUM_FLOOR_DB (-60.0f)
+#define SPECTRUM_FALL 0.8f
+
+// written by the audio thread only
+static float ring[SPECTRUM_RING];
+static SDL_atomic_t ringWrite;
+static SDL_atomic_t pending;
+static int channels = 2;
+
+static SDL_Thread* worker = NULL;
+static SDL_sem* ready = NULL;
+static SDL_atomic_t quitting;
+
+// tables, built once before the worker starts
+static float window[SPECTRUM_FFT_SIZE];
+static float cosTable[SPECTRUM_FFT_SIZE / 2];
+static float sinTable[SPECTRUM_FFT_SIZE / 2];
+static int bitrev[SPECTRUM_FFT_SIZE];
+static int barStart[SPECTRUM_BARS + 1];
+static bool tablesReady = false;
+
+// double buffer: the worker fills bars[(seq + 1) & 1] then bumps seq
+static float bars[2][SPECTRUM_BARS];
+static SDL_atomic_t seq;
+static SDL_atomic_t costNanos;
+
+//ANALYSIS
+static void buildTables(const int rate) {
+    const int n = SPECTRUM_FFT_SIZE;
+    int bits = 0;
+    while (1 << bits < n) {
+        bits++;
+    }
+    for (int i = 0; i < n; i++) {
+        window[i] = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * (float) i / (float) (n - 1));
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= (i >> b & 1) << (bits - 1 - b);
+        }
+        bitrev[i] = r;
+    }
+    for (int i = 0; i < n / 2; i++) {
+        cosTable[i] = cosf(2.0f * (float) M_PI * (float) i / (float) n);
+        sinTable[i] = sinf(2.0f * (float) M_PI * (float) i / (float) n);
+    }
+    // log spaced bands, every bar gets at least one bin of its own
+    const float high = SPECTRUM_HIGH_HZ < (float) rate / 2 ? SPECTRUM_HIGH_HZ : (float) rate / 2;
+    for (int b = 0; b <= SPECTRUM_BARS; b++) {
+        const float f = SPECTRUM_LOW_HZ * powf(high / SPECTRUM_LOW_HZ, (float) b / SPECTRUM_BARS);
+        int bin = (int) (f * (float) n / (float) rate + 0.5f);
+        if (b > 0 && bin <= barStart[b - 1]) {
+            bin = barStart[b - 1] + 1;
+        }
+        barStart[b] = bin < n / 2 ? bin : n / 2;
+    }
+    tablesReady = true;
+}
+
+static void fft(float* re, float* im) {
+    const int n = SPECTRUM_FFT_SIZE;
+    for (int i = 0; i < n; i++) {
+        const int j = bitrev[i];
+        if (j > i) {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (int size = 2; size <= n; size <<= 1) {
+        const int half = size / 2;
+        const int step = n / size;
+        for (int start = 0; start < n; start += size) {
+            for (int k = 0; k < half; k++) {
+                const float wr = cosTable[k * step];
+                const float wi = -sinTable[k * step];
+                const int a = start + k;
+                const int b = a + half;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+// windowed FFT of one block into smoothed 0..1 bar levels
+static void analyzeBlock(float* re, float* im, float* levels) {
+    const int n = SPECTRUM_FFT_SIZE;
+    // a full scale sine lands at 0dB: hann window sum is n / 2
+    const float norm = 16.0f / ((float) n * (float) n);
+    for (int i = 0; i < n; i++) {
+        re[i] *= window[i];
+        im[i] = 0;
+    }
+    fft(re, im);
+    for (int b = 0; b < SPECTRUM_BARS; b++) {
+        float power = 0;
+        const int count = barStart[b + 1] - barStart[b];
+        for (int k = barStart[b]; k < barStart[b + 1]; k++) {
+            power += re[k] * re[k] + im[k] * im[k];
+        }
+        const float db = 10.0f * log10f(power * norm / (float) (count > 0 ? count : 1) + 1e-12f);
+        float level = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB;
+        level = level < 0 ? 0 : level > 1 ? 1 : level;
+        levels[b] = level > levels[b] ? level : levels[b] * SPECTRUM_FALL + level * (1 - SPECTRUM_FALL);
+    }
+}
+//END ANALYSIS
+
+static void publish(const float* levels) {
+    const int next = SDL_AtomicGet(&seq) + 1;
+    memcpy(bars[next & 1], levels, sizeof(bars[0]));
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&seq, next);
+}
+
+// audio thread: downmix into the ring and wake the worker once per block
+static void postMix(void* udata, Uint8* stream, int len) {
+    const Sint16* samples = (const Sint16*) stream;
+    const int frames = len / (int) (sizeof(Sint16) * channels);
+    int w = SDL_AtomicGet(&ringWrite);
+    for (int i = 0; i < frames; i++) {
+        float sum = 0;
+        for (int c = 0; c < channels; c++) {
+            sum += samples[i * channels + c];
+        }
+        ring[w] = sum / (32768.0f * (float) channels);
+        w = (w + 1) & (SPECTRUM_RING - 1);
+    }
+    SDL_AtomicSet(&ringWrite, w);
+    if (SDL_AtomicAdd(&pending, frames) + frames >= SPECTRUM_FFT_SIZE) {
+        SDL_AtomicSet(&pending, 0);
+        SDL_SemPost(ready);
+    }
+}
+
+static int spectrumWorker(void* data) {
+    float re[SPECTRUM_FFT_SIZE];
+    float im[SPECTRUM_FFT_SIZE];
+    float levels[SPECTRUM_BARS] = {0};
+    Uint64 totalTicks = 0;
+    int blocks = 0;
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    while (!SDL_AtomicGet(&quitting)) {
+        if (SDL_SemWaitTimeout(ready, 100) != 0) {
+            continue;
+        }
+        // only the newest block is analyzed, a late worker skips ahead instead of queueing
+        const int end = SDL_AtomicGet(&ringWrite);
+        for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+            re[i] = ring[(end - SPECTRUM_FFT_SIZE + i) & (SPECTRUM_RING - 1)];
+        }
+        const Uint64 start = SDL_GetPerformanceCounter();
+        analyzeBlock(re, im, levels);
+        totalTicks += SDL_GetPerformanceCounter() - start;
+        publish(levels);
+        if (++blocks == 256) {
+            SDL_AtomicSet(&costNanos, (int) (totalTicks * 1000000000 / SDL_GetPerformanceFrequency() / blocks));
+            totalTicks = 0;
+            blocks = 0;
+        }
+    }
+    return 0;
+}
+
+bool spectrum_init() {
+    int rate = 0;
+    Uint16 format = 0;
+    if (Mix_QuerySpec(&rate, &format, &channels) == 0 || format != AUDIO_S16SYS || channels < 1) {
+        SDL_Log("Spectrum needs an open S16 audio device, visualizer disabled");
+        return false;
+    }
+    buildTables(rate);
+    ready = SDL_CreateSemaphore(0);
+    if (ready == NULL) {
+        SDL_Log("Failed to create spectrum semaphore!\nSDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    SDL_AtomicSet(&quitting, 0);
+    worker = SDL_CreateThread(spectrumWorker, "spectrum", NULL);
+    if (worker == NULL) {
+        SDL_Log("Failed to start spectrum worker!\nSDL_Error: %s", SDL_GetError());
+        return false;
+    }
+    Mix_SetPostMix(postMix, NULL);
+    return true;
+}
+
+// copies the latest published levels, retries if the worker lapped the buffer mid-copy
+bool spectrum_read(float* levels) {
+    if (worker == NULL) {
+        return false;
+    }
+    int before;
+    do {
+        before = SDL_AtomicGet(&seq);
+        SDL_MemoryBarrierAcquire();
+        memcpy(levels, bars[before & 1], sizeof(bars[0]));
+        SDL_MemoryBarrierAcquire();
+        // any publish since means the worker may already be refilling the buffer we copied
+    } while (SDL_AtomicGet(&seq) != before);
+    return before > 0;
+}
+
+double spectrum_costMicros() {
+    return SDL_AtomicGet(&costNanos) / 1000.0;
+}
+
+void spectrum_quit() {
+    if (worker == NULL) {
+        return;
+    }
+    Mix_SetPostMix(NULL, NULL);
+    SDL_AtomicSet(&quitting, 1);
+    SDL_SemPost(ready);
+    SDL_WaitThread(worker, NULL);
+    worker = NULL;
+    SDL_DestroySemaphore(ready);
+    ready = NULL;
+}
+
+// average analysis cost per block on white noise, in microseconds
+double spectrum_benchFft(const int blocks) {
+    float re[SPECTRUM_FFT_SIZE];
+    float im[SPECTRUM_FFT_SIZE];
+    float levels[SPECTRUM_BARS] = {0};
+    if (!tablesReady) {
+        buildTables(MIX_DEFAULT_FREQUENCY);
+    }
+    Uint64 total = 0;
+    for (int b = 0; b < blocks; b++) {
+        for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+            re[i] = (float) rand() / (float) RAND_MAX * 2.0f - 1.0f;
+        }
+        const Uint64 start = SDL_GetPerformanceCounter();
+        analyzeBlock(re, im, levels);
+        total += SDL_GetPerformanceCounter() - start;
+    }
+    return blocks > 0 ? (double) total * 1000000.0 / (double) SDL_GetPerformanceFrequency() / blocks : 0;
+}
@@ -0,0 +1,22 @@
+//
+// Spectrum visualizer fed by a Mix_SetPostMix tap. The audio thread only copies
+// samples into a ring, a worker runs the FFT and publishes bar levels through a
+// lock-free double buffer that the renderer reads once per frame.
+//
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "stdbool.h"
+#include <SDL.h>
+
+#define SPECTRUM_FFT_SIZE 1024
+#define SPECTRUM_BARS 32
+
+bool spectrum_init();
+bool spectrum_read(float* levels);
+double spectrum_costMicros();
+void spectrum_quit();
+
+double spectrum_benchFft(int blocks);
+#endif //SPECTRUM_H
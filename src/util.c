@@ -9,6 +9,7 @@
 
 Ek_List* list_new (int capacity) {
     Ek_List* list = malloc(sizeof(Ek_List));
+    list->size = 0;
     list->capacity = capacity;
     list->arr = malloc(sizeof(char*) * capacity);
     return list;
@@ -21,7 +22,7 @@ void list_add(Ek_List* list, char* in) {
     if (list->size >= list->capacity) {
         char** newArr = malloc(sizeof(char*) * list->capacity * 2);
         list->capacity = list->capacity * 2;
-        for (int i = 0; i < list->capacity; i++) {
+        for (int i = 0; i < list->size; i++) {
             newArr[i] = list->arr[i];
         }
         newArr[list->size++] = in;
@@ -39,13 +40,26 @@ void list_deleteIndex(Ek_List* list, const int index) {
     for (int i = index; i < list->size - 1; i++) {
         list->arr[i] = list->arr[i + 1];
     }
-    list->arr[list->size--] = NULL;
+    list->arr[--list->size] = NULL;
+}
+
+int list_indexOf(const Ek_List* list, const char* in) {
+    if (list == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < list->size; i++) {
+        if (list->arr[i] == in) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 void destroyLinkedList(Ek_LinkedList *head) {
     while (head != NULL) {
         Ek_LinkedList *temp = head;
         head = head->next;
+        free(temp->key);
         free(temp);
     }
 }
@@ -69,20 +83,17 @@ void* map_get(Ek_Map *map, char *key) {
     }
     const unsigned long index = getIndex(*map, key);
     Ek_LinkedList *node = map->mapArr[index];
-    if (map->mapArr[index] == NULL) {
-        return NULL;
-    }
-    while (node->next && strcmp(node->key, key) != 0) {
+    while (node != NULL && strcmp(node->key, key) != 0) {
         node = node->next;
     }
-    return node->value;
+    return node == NULL ? NULL : node->value;
 }
 
 Ek_Map* map_new(const int cap) {
     Ek_Map* map = malloc(sizeof(Ek_Map));
     map->capacity = cap;
     map->size = 0;
-    map->mapArr = malloc(sizeof(void*) * cap);
+    map->mapArr = calloc(cap, sizeof(void*));
     return map;
 }
 
@@ -92,20 +103,41 @@ void map_put(Ek_Map *map, char *key, void *value) {
     }
     const unsigned long mapIndex = getIndex(*map, key);
     Ek_LinkedList *node = map->mapArr[mapIndex];
+    Ek_LinkedList *next = malloc(sizeof(Ek_LinkedList));
+    next->key = strdup(key);
+    next->value = value;
+    next->next = NULL;
     if (node == NULL) {
-        node = malloc(sizeof(Ek_LinkedList));
-        strcpy(node->key, key);
-        node->value = value;
-        map->mapArr[mapIndex] = node;
+        map->mapArr[mapIndex] = next;
     } else {
-        Ek_LinkedList *next = malloc(sizeof(Ek_LinkedList));
-        strcpy(next->key, key);
-        next->value = value;
+        while (node->next != NULL) {
+            node = node->next;
+        }
         node->next = next;
     }
     map->size++;
 }
 
+void* map_remove(Ek_Map* map, char* key) {
+    if (map == NULL || key == NULL) {
+        return NULL;
+    }
+    Ek_LinkedList** link = &map->mapArr[getIndex(*map, key)];
+    while (*link != NULL && strcmp((*link)->key, key) != 0) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return NULL;
+    }
+    Ek_LinkedList* node = *link;
+    void* value = node->value;
+    *link = node->next;
+    free(node->key);
+    free(node);
+    map->size--;
+    return value;
+}
+
 char** map_keys(const Ek_Map *map, int* keycount) {
     if (map == NULL) {
         return NULL;
@@ -129,11 +161,13 @@ void map_destroy(Ek_Map *map) {
     if (map == NULL) {
         return;
     }
-    for (int i = 0; i < map->size; i++) {
+    for (int i = 0; i < map->capacity; i++) {
         if (map->mapArr[i] != NULL) {
             destroyLinkedList(map->mapArr[i]);
         }
     }
+    free(map->mapArr);
+    free(map);
 }
 
 void startTimer(LTimer* t) {
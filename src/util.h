@@ -11,7 +11,7 @@
 #include <SDL.h>
 
 typedef struct Ek_LinkedList {
-    char key[MAP_KEY_MAX];
+    char* key;
     void *value;
     struct Ek_LinkedList *next;
 } Ek_LinkedList;
@@ -40,6 +40,7 @@ Ek_Map* map_new(int cap);
 void* map_get(Ek_Map* map, char* key);
 char** map_keys(const Ek_Map *map, int* keycount);
 void map_put(Ek_Map* map, char* key, void* value);
+void* map_remove(Ek_Map* map, char* key);
 void map_destroy(Ek_Map* map);
 
 void startTimer(LTimer* t);
@@ -48,4 +49,5 @@ void stopTimer(LTimer* t);
 Ek_List* list_new(const int capacity);
 void list_add(Ek_List* list, char* in);
 void list_deleteIndex(Ek_List* list, const int index);
+int list_indexOf(const Ek_List* list, const char* in);
 #endif //UTIL_H
@@ -0,0 +1,248 @@
+//
+// Music dir watcher, see watch.h
+//
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "watch.h"
+
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "dirent.h"
+#include "sys/stat.h"
+
+// files count once they are fully written or moved in, creates are only used for dirs
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE)
+// a long copy still shows up every few seconds instead of all at the end
+#define WATCH_MAX_DELAY_MS 5000
+
+typedef struct {
+    int wd;
+    char* rel; // "" for the root
+} WatchDir;
+
+typedef struct {
+    WatchEvent event;
+    char name[WATCH_PATH_MAX];
+} PendingEvent;
+
+static int fd = -1;
+static char rootDir[WATCH_PATH_MAX];
+static WatchDir* dirs = NULL;
+static int dirCount = 0;
+static int dirCapacity = 0;
+static PendingEvent pending[WATCH_PENDING_MAX];
+static int pendingCount = 0;
+static Uint64 firstPendingTicks = 0;
+static Uint64 lastEventTicks = 0;
+
+static bool joinPath(char* out, const char* rel, const char* name) {
+    const int len = rel[0] == '\0' ? snprintf(out, WATCH_PATH_MAX, "%s", name) : snprintf(out, WATCH_PATH_MAX, "%s/%s", rel, name);
+    return len < WATCH_PATH_MAX;
+}
+
+static void fullPath(char* out, const int size, const char* rel) {
+    snprintf(out, size, rel[0] == '\0' ? "%s%s" : "%s/%s", rootDir, rel);
+}
+
+static void flush(WatchCallback callback) {
+    for (int i = 0; i < pendingCount; i++) {
+        callback(pending[i].event, pending[i].name);
+    }
+    pendingCount = 0;
+}
+
+// one entry per name, the latest event wins and moves to the back
+static void queueEvent(const WatchEvent event, const char* name, WatchCallback callback) {
+    for (int i = 0; i < pendingCount; i++) {
+        if (strcmp(pending[i].name, name) == 0) {
+            memmove(pending + i, pending + i + 1, sizeof(PendingEvent) * (pendingCount - i - 1));
+            pendingCount--;
+            break;
+        }
+    }
+    if (pendingCount == WATCH_PENDING_MAX) {
+        flush(callback);
+    }
+    if (pendingCount == 0) {
+        firstPendingTicks = SDL_GetTicks64();
+    }
+    pending[pendingCount].event = event;
+    strcpy(pending[pendingCount].name, name);
+    pendingCount++;
+}
+
+static WatchDir* findDir(const int wd) {
+    for (int i = 0; i < dirCount; i++) {
+        if (dirs[i].wd == wd) {
+            return &dirs[i];
+        }
+    }
+    return NULL;
+}
+
+static void rememberDir(const int wd, const char* rel) {
+    WatchDir* dir = findDir(wd);
+    if (dir != NULL) {
+        free(dir->rel);
+        dir->rel = strdup(rel);
+        return;
+    }
+    if (dirCount == dirCapacity) {
+        dirCapacity = dirCapacity == 0 ? 16 : dirCapacity * 2;
+        dirs = realloc(dirs, sizeof(WatchDir) * dirCapacity);
+    }
+    dirs[dirCount].wd = wd;
+    dirs[dirCount].rel = strdup(rel);
+    dirCount++;
+}
+
+static void forgetDirAt(const int i) {
+    free(dirs[i].rel);
+    dirs[i] = dirs[--dirCount];
+}
+
+// rel and everything below it, the kernel follows a moved dir so its old paths go stale
+static void unwatchTree(const char* rel) {
+    const size_t len = strlen(rel);
+    for (int i = 0; i < dirCount; i++) {
+        if (strncmp(dirs[i].rel, rel, len) == 0 && (dirs[i].rel[len] == '\0' || dirs[i].rel[len] == '/')) {
+            inotify_rm_watch(fd, dirs[i].wd);
+            forgetDirAt(i--);
+        }
+    }
+}
+
+// files already inside a dir that was just created / moved in are reported as adds
+static void addWatchTree(const char* rel, WatchCallback callback, const bool reportFiles) {
+    char path[WATCH_PATH_MAX * 2];
+    fullPath(path, sizeof(path), rel);
+    const int wd = inotify_add_watch(fd, path, WATCH_MASK);
+    if (wd < 0) {
+        printf("Failed to watch %s, errno: %d\n", path, errno);
+        return;
+    }
+    rememberDir(wd, rel);
+
+    DIR* dirp = opendir(path);
+    if (dirp == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    struct stat filestat;
+    while ((entry = readdir(dirp))) {
+        char child[WATCH_PATH_MAX];
+        char childPath[WATCH_PATH_MAX * 2];
+        if (entry->d_name[0] == '.' || !joinPath(child, rel, entry->d_name)) {
+            continue;
+        }
+        fullPath(childPath, sizeof(childPath), child);
+        if (stat(childPath, &filestat) == -1) {
+            continue;
+        }
+        if (S_ISDIR(filestat.st_mode)) {
+            addWatchTree(child, callback, reportFiles);
+        } else if (reportFiles && S_ISREG(filestat.st_mode)) {
+            queueEvent(WATCH_ADDED, child, callback);
+        }
+    }
+    closedir(dirp);
+}
+
+static void handleEvent(const struct inotify_event* ev, WatchCallback callback) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        pendingCount = 0;
+        callback(WATCH_RESCAN, NULL);
+        return;
+    }
+    if (ev->mask & IN_IGNORED) {
+        for (int i = 0; i < dirCount; i++) {
+            if (dirs[i].wd == ev->wd) {
+                forgetDirAt(i);
+                break;
+            }
+        }
+        return;
+    }
+    const WatchDir* dir = findDir(ev->wd);
+    char rel[WATCH_PATH_MAX];
+    if (dir == NULL || ev->len == 0 || ev->name[0] == '.' || !joinPath(rel, dir->rel, ev->name)) {
+        return;
+    }
+    if (ev->mask & IN_ISDIR) {
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            addWatchTree(rel, callback, true);
+        } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            unwatchTree(rel);
+            queueEvent(WATCH_REMOVED_DIR, rel, callback);
+        }
+    } else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        queueEvent(WATCH_ADDED, rel, callback);
+    } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        queueEvent(WATCH_REMOVED, rel, callback);
+    }
+}
+
+bool watch_init(const char* dir) {
+    snprintf(rootDir, sizeof(rootDir), "%s", dir);
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        printf("Failed to init inotify, errno: %d\n", errno);
+        return false;
+    }
+    addWatchTree("", NULL, false);
+    return true;
+}
+
+// non blocking, drains whatever the kernel has and flushes once things settle
+void watch_poll(WatchCallback callback) {
+    if (fd < 0) {
+        return;
+    }
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len;) {
+            const struct inotify_event* ev = (const struct inotify_event*) p;
+            handleEvent(ev, callback);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        lastEventTicks = SDL_GetTicks64();
+    }
+    const Uint64 now = SDL_GetTicks64();
+    if (pendingCount > 0 && (now - lastEventTicks >= WATCH_SETTLE_MS || now - firstPendingTicks >= WATCH_MAX_DELAY_MS)) {
+        flush(callback);
+    }
+}
+
+void watch_quit() {
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+    fd = -1;
+    for (int i = 0; i < dirCount; i++) {
+        free(dirs[i].rel);
+    }
+    free(dirs);
+    dirs = NULL;
+    dirCount = 0;
+    dirCapacity = 0;
+    pendingCount = 0;
+}
+#else
+bool watch_init(const char* dir) {
+    SDL_Log("File watching needs inotify, new music shows up after a restart");
+    return false;
+}
+
+void watch_poll(WatchCallback callback) {
+}
+
+void watch_quit() {
+}
+#endif
@@ -0,0 +1,30 @@
+//
+// Watches the music dir (and every subdir) for songs being copied in, removed
+// or renamed while we run. Events are coalesced until the tree has been quiet
+// for WATCH_SETTLE_MS so a bulk USB copy lands as one batch of adds.
+// inotify on linux, a no-op elsewhere.
+//
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "stdbool.h"
+
+#define WATCH_SETTLE_MS 500
+#define WATCH_PENDING_MAX 256
+#define WATCH_PATH_MAX 512
+
+typedef enum {
+    WATCH_ADDED,
+    WATCH_REMOVED,
+    WATCH_REMOVED_DIR,
+    WATCH_RESCAN
+} WatchEvent;
+
+// name is relative to the watched dir, NULL for WATCH_RESCAN
+typedef void (*WatchCallback)(WatchEvent event, const char* name);
+
+bool watch_init(const char* dir);
+void watch_poll(WatchCallback callback);
+void watch_quit();
+#endif //WATCH_H